@@ -0,0 +1,512 @@
+// throughput and latency of byte_ring, one json object per line on stdout so runs can be kept and compared
+// there is no build target, build it next to the library with the flags the library is used with:
+//		cc -std=gnu11 -O2 -DNDEBUG bench/br_bench.c byte_ring.c -o br_bench -lpthread
+//		./br_bench [prefix]
+// only the benchmarks whose name starts with prefix are run, all of them without one
+//
+// push_full		a full ring, so every push takes the behavior's overwrite or refusal path, a byte or a line at a time
+//						byte_policy pushes a byte at a time through br_push_oldest and the others instead of br_push
+// push_pop			a line pushed and a line popped, the path a ring that keeps up takes
+// pop					a full ring emptied with br_pop copying the line out, or with br_read_acquire leaving it in place
+// spsc					a producer and a consumer pinned to two cores, latency is from the push of a line to its pop
+// clear				br_clear and br_clear_secure as the backing store grows
+// selector			one consumer draining many rings of which only some have lines, looking at every ring in turn
+//						or asking a br_selector_t, an op is a line popped
+
+#define _GNU_SOURCE
+#include "../byte_ring.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#ifndef BR_BENCH_BYTES
+#define BR_BENCH_BYTES					((uint64_t) 64 << 20)
+#endif
+
+#ifndef BR_BENCH_MESSAGES
+#define BR_BENCH_MESSAGES				((size_t) 1 << 20)
+#endif
+
+typedef struct br_bench_geometry
+{
+	size_t									number_lines;
+	size_t									line_length;
+} br_bench_geometry_t;
+
+static const br_bench_geometry_t br_bench_geometries[] =
+{
+	{ 16,		64		},
+	{ 256,	64		},
+	{ 1024,	16		},
+	{ 64,		1024	},
+	{ 4096,	256		},
+};
+
+#define BR_BENCH_GEOMETRIES				(sizeof(br_bench_geometries) / sizeof(br_bench_geometries[0]))
+
+static const struct
+{
+	const char*							name;
+	BR_BEHAVIOR_FLAGS				behavior;
+	bool										(*push)(byte_ring_t*, uint8_t);
+}
+br_bench_behaviors[] =
+{
+	{ "oldest",		BR_OVERWRITE_OLDEST,	br_push_oldest	},
+	{ "newest",		BR_OVERWRITE_NEWEST,	br_push_newest	},
+	{ "refusal",	BR_OVERWRITE_REFUSAL,	br_push_refuse	},
+};
+
+#define BR_BENCH_BEHAVIORS				(sizeof(br_bench_behaviors) / sizeof(br_bench_behaviors[0]))
+
+static const char* br_bench_prefix = NULL;
+
+inline static uint64_t br_bench_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (((uint64_t) now.tv_sec * 1000000000u) + (uint64_t) now.tv_nsec);
+}
+
+static bool br_bench_wanted(const char* name)
+{
+	return ((NULL == br_bench_prefix) || (0 == strncmp(name, br_bench_prefix, strlen(br_bench_prefix))));
+}
+
+static int br_bench_ready(const uint8_t* data, size_t size)
+{
+	(void) data;
+	return ((0 == size) ? BR_NOT_READY : BR_READY);
+}
+
+// keeps the compiler from dropping work whose result is never looked at
+static volatile uint64_t br_bench_sink = 0;
+
+static void br_bench_report(const char* bench, const char* mode, const char* behavior,
+	const br_bench_geometry_t* geometry, uint64_t ops, uint64_t bytes, uint64_t elapsed_ns)
+{
+	double ns_per_op = (0 == ops) ? 0.0 : ((double) elapsed_ns / (double) ops);
+	double mb_per_s = (0 == elapsed_ns) ? 0.0 : (((double) bytes * 1000.0) / (double) elapsed_ns);
+
+	printf("{\"bench\":\"%s\",\"mode\":\"%s\",\"behavior\":\"%s\",\"lines\":%zu,\"length\":%zu,"
+		"\"ops\":%" PRIu64 ",\"ns_per_op\":%.3f,\"mb_per_s\":%.1f}\n",
+		bench, mode, behavior, geometry->number_lines, geometry->line_length, ops, ns_per_op, mb_per_s);
+}
+
+// br_pop moves on by itself after a line, but not past the last one, the next line is only reached by seeking
+static ssize_t br_bench_pop_one(byte_ring_t* ring, uint8_t* dst)
+{
+	ssize_t function_value = br_pop(ring, dst, br_bench_ready);
+	if((0 == function_value) && (true == br_seek(ring))) { function_value = br_pop(ring, dst, br_bench_ready); }
+	return (function_value);
+}
+
+static void br_bench_fill(byte_ring_t* ring, const uint8_t* line, size_t length)
+{
+	while(false == br_is_full(ring))
+	{
+		br_push_bytes(ring, line, length);
+		if(false == br_advance_write_head(ring)) { break; }
+	}
+
+	// the write line is filled as well, so the next byte already meets the behavior
+	br_push_bytes(ring, line, length);
+}
+
+static void br_bench_push_full(const br_bench_geometry_t* geometry, const char* behavior_name, BR_BEHAVIOR_FLAGS behavior,
+	bool (*push)(byte_ring_t*, uint8_t))
+{
+	size_t length = geometry->line_length;
+	uint64_t lines = BR_BENCH_BYTES / length;
+	uint8_t* line = calloc(length, sizeof(uint8_t));
+	byte_ring_t* ring = br_create_full_alloc(geometry->number_lines, length, behavior);
+	if((NULL == line) || (NULL == ring)) { goto function_exit; }
+
+	// a byte at a time through br_push, the ring stays full the whole time
+	br_bench_fill(ring, line, length);
+	uint64_t started = br_bench_now();
+	for(uint64_t n = 0; n < lines * length; n++) { br_push(ring, (uint8_t) n); }
+	br_bench_report("push_full", "byte", behavior_name, geometry, lines * length, lines * length, br_bench_now() - started);
+
+	// a byte at a time through the entry point for the behavior, br_push_oldest and the others
+	br_clear(ring);
+	br_bench_fill(ring, line, length);
+	started = br_bench_now();
+	for(uint64_t n = 0; n < lines * length; n++) { push(ring, (uint8_t) n); }
+	br_bench_report("push_full", "byte_policy", behavior_name, geometry, lines * length, lines * length, br_bench_now() - started);
+
+	// a line at a time through br_push_bytes
+	br_clear(ring);
+	br_bench_fill(ring, line, length);
+	started = br_bench_now();
+	for(uint64_t n = 0; n < lines; n++) { br_push_bytes(ring, line, length); }
+	br_bench_report("push_full", "bulk", behavior_name, geometry, lines, lines * length, br_bench_now() - started);
+
+function_exit:
+	if(NULL != ring) { br_destroy(&ring); }
+	free(line);
+}
+
+static void br_bench_push_pop(const br_bench_geometry_t* geometry, const char* behavior_name, BR_BEHAVIOR_FLAGS behavior)
+{
+	size_t length = geometry->line_length;
+	uint64_t lines = BR_BENCH_BYTES / length;
+	uint8_t* line = calloc(length, sizeof(uint8_t));
+	uint8_t* dst = calloc(length, sizeof(uint8_t));
+	byte_ring_t* ring = br_create_full_alloc(geometry->number_lines, length, behavior);
+	if((NULL == line) || (NULL == dst) || (NULL == ring)) { goto function_exit; }
+
+	// the consumer is always a line behind, so no behavior ever has to overwrite or refuse
+	uint64_t started = br_bench_now();
+	for(uint64_t n = 0; n < lines; n++)
+	{
+		for(size_t i = 0; i < length; i++) { br_push(ring, line[i]); }
+		br_advance_write_head(ring);
+		br_bench_sink += (uint64_t) br_bench_pop_one(ring, dst);
+	}
+	br_bench_report("push_pop", "byte", behavior_name, geometry, lines, lines * length, br_bench_now() - started);
+
+	br_clear(ring);
+	started = br_bench_now();
+	for(uint64_t n = 0; n < lines; n++)
+	{
+		br_push_bytes(ring, line, length);
+		br_advance_write_head(ring);
+		br_bench_sink += (uint64_t) br_bench_pop_one(ring, dst);
+	}
+	br_bench_report("push_pop", "bulk", behavior_name, geometry, lines, lines * length, br_bench_now() - started);
+
+function_exit:
+	if(NULL != ring) { br_destroy(&ring); }
+	free(dst);
+	free(line);
+}
+
+// only the popping is timed, the ring is filled again between rounds
+static void br_bench_pop(const br_bench_geometry_t* geometry)
+{
+	size_t length = geometry->line_length;
+	uint64_t rounds = BR_BENCH_BYTES / (length * geometry->number_lines) + 1;
+	uint8_t* line = calloc(length, sizeof(uint8_t));
+	uint8_t* dst = calloc(length, sizeof(uint8_t));
+	byte_ring_t* ring = br_create_full_alloc(geometry->number_lines, length, BR_OVERWRITE_REFUSAL);
+	if((NULL == line) || (NULL == dst) || (NULL == ring)) { goto function_exit; }
+
+	uint64_t copied = 0;
+	uint64_t viewed = 0;
+	uint64_t copied_ns = 0;
+	uint64_t viewed_ns = 0;
+
+	for(uint64_t round = 0; round < rounds; round++)
+	{
+		br_clear(ring);
+		br_bench_fill(ring, line, length);
+		br_advance_write_head(ring);
+
+		uint64_t started = br_bench_now();
+		br_seek(ring);
+		while(0 < br_pop(ring, dst, br_bench_ready)) { ++ copied; }
+		copied_ns += br_bench_now() - started;
+
+		br_clear(ring);
+		br_bench_fill(ring, line, length);
+		br_advance_write_head(ring);
+
+		br_span_t span;
+		started = br_bench_now();
+		br_seek(ring);
+		while(true == br_read_acquire(ring, &span))
+		{
+			br_bench_sink += span.data[0] + span.size;
+			br_read_release(ring);
+			++ viewed;
+		}
+		viewed_ns += br_bench_now() - started;
+	}
+
+	br_bench_report("pop", "copy", "refusal", geometry, copied, copied * length, copied_ns);
+	br_bench_report("pop", "view", "refusal", geometry, viewed, viewed * length, viewed_ns);
+
+function_exit:
+	if(NULL != ring) { br_destroy(&ring); }
+	free(dst);
+	free(line);
+}
+
+typedef struct br_bench_spsc
+{
+	byte_ring_t*						ring;
+	size_t									length;
+	size_t									messages;
+	uint64_t*								latency_ns;
+	int											cpu;
+} br_bench_spsc_t;
+
+static void br_bench_pin(int cpu)
+{
+	if(0 > cpu) { return; }
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// the first two cores this process may run on, -1 when there is only one
+static void br_bench_pick_cpus(int* producer, int* consumer)
+{
+	cpu_set_t set;
+	*producer = -1;
+	*consumer = -1;
+	if(0 != sched_getaffinity(0, sizeof(set), &set)) { return; }
+
+	for(int cpu = 0; (cpu < CPU_SETSIZE) && (0 > *consumer); cpu++)
+	{
+		if(0 == CPU_ISSET(cpu, &set)) { continue; }
+		if(0 > *producer)	{ *producer = cpu; }
+		else							{ *consumer = cpu; }
+	}
+
+	if(0 > *consumer) { *producer = -1; }
+}
+
+// every line starts with the time it was pushed
+static void* br_bench_spsc_producer(void* argument)
+{
+	br_bench_spsc_t* bench = (br_bench_spsc_t*) argument;
+	uint8_t line[1024] = { 0 };
+	br_bench_pin(bench->cpu);
+
+	for(size_t n = 0; n < bench->messages; n++)
+	{
+		uint64_t now = br_bench_now();
+		memcpy(line, &now, sizeof(now));
+		br_push_bytes(bench->ring, line, bench->length);
+		while(false == br_advance_write_head(bench->ring)) { }
+	}
+
+	return (NULL);
+}
+
+static int br_bench_compare(const void* a, const void* b)
+{
+	uint64_t left = *((const uint64_t*) a);
+	uint64_t right = *((const uint64_t*) b);
+	return ((left > right) - (left < right));
+}
+
+static void br_bench_spsc_run(const br_bench_geometry_t* geometry)
+{
+	int producer_cpu = -1;
+	int consumer_cpu = -1;
+	br_bench_pick_cpus(&producer_cpu, &consumer_cpu);
+
+	br_bench_spsc_t bench =
+	{
+		.ring				= br_create_full_alloc(geometry->number_lines, geometry->line_length, BR_OVERWRITE_REFUSAL | BR_CONCURRENT_SPSC),
+		.length			= geometry->line_length,
+		.messages		= BR_BENCH_MESSAGES,
+		.latency_ns	= calloc(BR_BENCH_MESSAGES, sizeof(uint64_t)),
+		.cpu				= producer_cpu,
+	};
+
+	pthread_t producer;
+	if((NULL == bench.ring) || (NULL == bench.latency_ns) || (sizeof(uint64_t) > bench.length) || (1024 < bench.length))
+	{
+		goto function_exit;
+	}
+
+	br_bench_pin(consumer_cpu);
+	uint64_t started = br_bench_now();
+	if(0 != pthread_create(&producer, NULL, br_bench_spsc_producer, &bench)) { goto function_exit; }
+
+	size_t received = 0;
+	br_span_t span;
+	while(received < bench.messages)
+	{
+		if(false == br_read_acquire(bench.ring, &span))
+		{
+			br_seek(bench.ring);
+			continue;
+		}
+
+		uint64_t pushed = 0;
+		memcpy(&pushed, span.data, sizeof(pushed));
+		bench.latency_ns[received++] = br_bench_now() - pushed;
+		br_read_release(bench.ring);
+	}
+
+	uint64_t elapsed_ns = br_bench_now() - started;
+	pthread_join(producer, NULL);
+	qsort(bench.latency_ns, bench.messages, sizeof(uint64_t), br_bench_compare);
+
+	printf("{\"bench\":\"spsc\",\"mode\":\"%s\",\"behavior\":\"refusal\",\"lines\":%zu,\"length\":%zu,\"ops\":%zu,"
+		"\"msgs_per_s\":%.0f,\"p50_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64 "}\n",
+		(0 > consumer_cpu) ? "one_core" : "cross_core", geometry->number_lines, geometry->line_length, bench.messages,
+		((double) bench.messages * 1e9) / (double) elapsed_ns,
+		bench.latency_ns[bench.messages / 2],
+		bench.latency_ns[(bench.messages * 99) / 100],
+		bench.latency_ns[(bench.messages * 999) / 1000]);
+
+function_exit:
+	if(NULL != bench.ring) { br_destroy(&bench.ring); }
+	free(bench.latency_ns);
+}
+
+static void br_bench_clear(void)
+{
+	static const size_t lengths[] = { 64, 1024, 16384, 262144 };
+	br_bench_geometry_t geometry = { 256, 0 };
+
+	for(size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
+	{
+		geometry.line_length = lengths[i];
+		byte_ring_t* ring = br_create_full_alloc(geometry.number_lines, geometry.line_length, BR_OVERWRITE_OLDEST);
+		if(NULL == ring) { continue; }
+
+		// the secure clear touches the whole store, so it gets fewer rounds
+		uint64_t store = geometry.number_lines * geometry.line_length;
+		uint64_t rounds = BR_BENCH_BYTES / store + 1;
+		uint64_t elapsed_ns = 0;
+
+		for(uint64_t round = 0; round < rounds * 64; round++)
+		{
+			br_push(ring, (uint8_t) round);
+			br_advance_write_head(ring);
+
+			uint64_t started = br_bench_now();
+			br_clear(ring);
+			elapsed_ns += br_bench_now() - started;
+		}
+
+		br_bench_report("clear", "clear", "oldest", &geometry, rounds * 64, 0, elapsed_ns);
+
+		uint64_t started = br_bench_now();
+		for(uint64_t round = 0; round < rounds; round++) { br_clear_secure(ring); }
+		br_bench_report("clear", "secure", "oldest", &geometry, rounds, rounds * store, br_bench_now() - started);
+
+		br_destroy(&ring);
+	}
+}
+
+#ifndef BR_BENCH_SELECTOR_RINGS
+#define BR_BENCH_SELECTOR_RINGS		1024
+#endif
+
+// every round pushes a line to each active ring, then only the draining is timed
+static void br_bench_selector(size_t active)
+{
+	br_bench_geometry_t geometry = { 16, 64 };
+	uint8_t line[64] = { 0 };
+	uint8_t dst[64];
+	uint64_t rounds = BR_BENCH_MESSAGES / active + 1;
+	uint64_t popped[2] = { 0, 0 };
+	uint64_t elapsed_ns[2] = { 0, 0 };
+
+	br_pool_t* pool = br_pool_create(BR_BENCH_SELECTOR_RINGS, geometry.number_lines, geometry.line_length, BR_OVERWRITE_REFUSAL);
+	br_selector_t* selector = br_selector_create(BR_BENCH_SELECTOR_RINGS);
+	byte_ring_t** rings = calloc(BR_BENCH_SELECTOR_RINGS, sizeof(byte_ring_t*));
+	if((NULL == pool) || (NULL == selector) || (NULL == rings)) { goto function_exit; }
+
+	for(size_t i = 0; i < BR_BENCH_SELECTOR_RINGS; i++)
+	{
+		rings[i] = br_pool_get(pool);
+		br_selector_add(selector, rings[i], 1);
+	}
+
+	// the active rings are spread over the whole set, so the scan cannot stop early
+	size_t stride = BR_BENCH_SELECTOR_RINGS / active;
+
+	for(uint64_t round = 0; round < rounds; round++)
+	{
+		for(size_t mode = 0; mode < 2; mode++)
+		{
+			for(size_t i = 0; i < active; i++)
+			{
+				br_push_bytes(rings[i * stride], line, sizeof(line));
+				br_advance_write_head(rings[i * stride]);
+			}
+
+			uint64_t started = br_bench_now();
+			if(0 == mode)
+			{
+				for(size_t i = 0; i < BR_BENCH_SELECTOR_RINGS; i++)
+				{
+					if(false == br_is_empty(rings[i])) { popped[mode] += (0 < br_bench_pop_one(rings[i], dst)); }
+				}
+			}
+			else
+			{
+				byte_ring_t* ring = NULL;
+				while(NULL != (ring = br_selector_next(selector))) { popped[mode] += (0 < br_pop(ring, dst, br_bench_ready)); }
+			}
+			elapsed_ns[mode] += br_bench_now() - started;
+		}
+	}
+
+	static const char* modes[] = { "scan", "selector" };
+	for(size_t mode = 0; mode < 2; mode++)
+	{
+		double ns_per_op = (0 == popped[mode]) ? 0.0 : ((double) elapsed_ns[mode] / (double) popped[mode]);
+		printf("{\"bench\":\"selector\",\"mode\":\"%s\",\"rings\":%d,\"active\":%zu,\"ops\":%" PRIu64 ",\"ns_per_op\":%.3f}\n",
+			modes[mode], BR_BENCH_SELECTOR_RINGS, active, popped[mode], ns_per_op);
+	}
+
+function_exit:
+	if(NULL != selector) { br_selector_destroy(&selector); }
+	if(NULL != pool) { br_pool_destroy(&pool); }
+	free(rings);
+}
+
+int main(int argc, char** argv)
+{
+	if(1 < argc) { br_bench_prefix = argv[1]; }
+
+	// the build the numbers came from, results from different builds are not comparable
+	printf("{\"bench\":\"build\",\"shred_old_data\":%s,\"stats\":%s,\"trace\":%s,\"assert_active\":%s}\n",
+#	ifdef BR_SHRED_OLD_DATA
+		"true",
+#	else
+		"false",
+#	endif
+#	ifdef BR_STATS
+		"true",
+#	else
+		"false",
+#	endif
+#	ifdef BR_TRACE
+		"true",
+#	else
+		"false",
+#	endif
+#	ifdef BR_ASSERT_ACTIVE
+		"true"
+#	else
+		"false"
+#	endif
+		);
+
+	for(size_t g = 0; g < BR_BENCH_GEOMETRIES; g++)
+	{
+		for(size_t b = 0; b < BR_BENCH_BEHAVIORS; b++)
+		{
+			if(true == br_bench_wanted("push_full")) { br_bench_push_full(&br_bench_geometries[g], br_bench_behaviors[b].name, br_bench_behaviors[b].behavior,
+				br_bench_behaviors[b].push); }
+			if(true == br_bench_wanted("push_pop")) { br_bench_push_pop(&br_bench_geometries[g], br_bench_behaviors[b].name, br_bench_behaviors[b].behavior); }
+		}
+
+		if(true == br_bench_wanted("pop")) { br_bench_pop(&br_bench_geometries[g]); }
+		if(true == br_bench_wanted("spsc")) { br_bench_spsc_run(&br_bench_geometries[g]); }
+		fflush(stdout);
+	}
+
+	if(true == br_bench_wanted("clear")) { br_bench_clear(); }
+
+	if(true == br_bench_wanted("selector"))
+	{
+		for(size_t active = 4; active <= BR_BENCH_SELECTOR_RINGS; active *= 16) { br_bench_selector(active); }
+	}
+	return (0);
+}
@@ -1,18 +1,102 @@
+// mmap's MAP_ANONYMOUS and MAP_HUGETLB, ftruncate, syscall and clock_gettime are only declared with a feature test macro
+#ifndef _GNU_SOURCE
+#	define _GNU_SOURCE
+#endif
+
 #include "byte_ring.h"
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#endif
+
+#ifdef __linux__
+#	include <sys/mman.h>
+#	include <sys/syscall.h>
+#	include <linux/memfd.h>
+#	include <linux/mempolicy.h>
+#	include <linux/futex.h>
+#	include <sys/eventfd.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <sched.h>
+#endif
 
 #ifdef BR_ASSERT_ACTIVE
 #	include <assert.h>
 #endif
 
+// the producer and consumer state are kept this far apart so the two sides never share a cache line
+#ifndef BR_CACHE_LINE_SIZE
+#	define BR_CACHE_LINE_SIZE				64
+#endif
+
+// BR_PAGES_HUGETLB and BR_PAGES_TRANSPARENT_HUGE stores are mapped in multiples of this
+#ifndef BR_HUGE_PAGE_SIZE
+#	define BR_HUGE_PAGE_SIZE				(2 * 1024 * 1024)
+#endif
+
+// how many times br_pop_wait checks for a line before it parks, it adapts between the two to how often spinning pays off
+#ifndef BR_WAIT_SPINS_MIN
+#	define BR_WAIT_SPINS_MIN				16
+#endif
+
+#ifndef BR_WAIT_SPINS_MAX
+#	define BR_WAIT_SPINS_MAX				4096
+#endif
+
+// how many lines a BR_BATCHED_PUBLISH ring holds back before publishing them, until br_set_publish_batch says otherwise
+#ifndef BR_PUBLISH_BATCH_LINES
+#	define BR_PUBLISH_BATCH_LINES	32
+#endif
+
+// the most lines br_fill_from_fd and br_drain_to_fd hand to one readv or writev
+#ifndef BR_IOV_MAX
+#	define BR_IOV_MAX							64
+#endif
+
+// br_alloc_options_t numa_node has to be below this
+#ifndef BR_MAX_NUMA_NODES
+#	define BR_MAX_NUMA_NODES				1024
+#endif
+
 #define BR_BACKING_STORE_ALLOC			(1 << 3)
 #define BR_STRUCT_ALLOC					(1 << 4)
 #define BR_SIZEMAP_ALLOC				(1 << 5)
 
-#define BR_BEHAVIOR_FLAGS_MASK			(BR_OVERWRITE_OLDEST	|	BR_OVERWRITE_NEWEST	|	BR_OVERWRITE_REFUSAL)
-#define BR_ALLOC_FLAGS_MASK				(BR_BACKING_STORE_ALLOC	|	BR_STRUCT_ALLOC		|	BR_SIZEMAP_ALLOC)
-#define BR_IMMUTABLE_FLAGS_MASK			(BR_ALLOC_FLAGS_MASK	|	BR_BEHAVIOR_FLAGS_MASK)
+// the backing store was mapped, by br_map_mirrored or br_map_anonymous, and is unmapped instead of freed
+#define BR_BACKING_STORE_MAPPED			(1 << 19)
+
+// the ring lives in a file mapping made by br_create_mapped or br_open_mapped, br_destroy unmaps it
+#define BR_FILE_MAPPED					(1 << 20)
+
+// the ring sits in the arena of a br_pool, which no other process sees, see br_is_shareable
+#define BR_POOL_RING						(1 << 22)
+
+// lines are packed back to back in the backing store instead of one line length apart, see br_create_packed_alloc
+#define BR_PACKED_RECORDS				(1 << 17)
+#define BR_OFFSETMAP_ALLOC				(1 << 18)
+
+// the read line, the write line and the line after it, with the end of the backing store skipped before two of them
+#define BR_PACKED_MIN_LINES				5
+
+#define BR_OVERWRITE_FLAGS_MASK			(BR_OVERWRITE_OLDEST	|	BR_OVERWRITE_NEWEST	|	BR_OVERWRITE_REFUSAL)
+#define BR_CONCURRENT_FLAGS_MASK		(BR_CONCURRENT_SPSC		|	BR_CONCURRENT_MPSC)
+#define BR_BEHAVIOR_FLAGS_MASK			(BR_OVERWRITE_FLAGS_MASK	|	BR_CONCURRENT_FLAGS_MASK	|	BR_MIRRORED_STORE	| \
+											BR_WAITABLE	|	BR_BATCHED_PUBLISH)
+
+// who the producer has to wake when it publishes a line, see br_pop_wait and br_arm_notify_fd
+#define BR_WAITING_FUTEX				(1 << 0)
+#define BR_WAITING_FD					(1 << 1)
+
+#define BR_ALLOC_FLAGS_MASK				(BR_BACKING_STORE_ALLOC	|	BR_STRUCT_ALLOC		|	BR_SIZEMAP_ALLOC	|	BR_OFFSETMAP_ALLOC	| \
+											BR_BACKING_STORE_MAPPED	|	BR_FILE_MAPPED		|	BR_POOL_RING)
+#define BR_GEOMETRY_FLAGS_MASK			(BR_PACKED_RECORDS)
+#define BR_IMMUTABLE_FLAGS_MASK			(BR_ALLOC_FLAGS_MASK	|	BR_BEHAVIOR_FLAGS_MASK	|	BR_GEOMETRY_FLAGS_MASK)
 #define BR_EVENT_FLAGS_MASK				(~BR_IMMUTABLE_FLAGS_MASK)
 
 /*
@@ -20,45 +104,219 @@
 BR_FLAG_LINE_WRAPPED	=		(1 << 8),
 */
 
+#ifdef BR_STATS
+// each side only writes its own counters, so counting never touches a line the other side writes
+typedef struct br_producer_stats
+{
+	uint64_t								bytes_pushed;
+	uint64_t								lines_pushed;
+	uint64_t								overwrites_oldest;
+	uint64_t								overwrites_newest;
+	uint64_t								refusals;
+	uint64_t								high_water_lines;
+	uint64_t								fill_histogram[BR_STATS_FILL_BUCKETS];
+} br_producer_stats_t;
+
+typedef struct br_consumer_stats
+{
+	uint64_t								lines_popped;
+	uint64_t								truncations;
+	uint64_t								high_water_lines;
+} br_consumer_stats_t;
+#endif
+
 struct byte_ring
 {
+	// set up by the create functions, after that only read by both sides
+	// flags set from outside the ring with br_set_flag are also kept in bit_flags
+	// the ring holds no pointers, its memory is kept as distances from the struct, see br_get_distance
+	// so a ring built in shared memory works from every process that maps it, wherever it is mapped, see br_attach
 	uint32_t								bit_flags;
-	bool (*push_function)(struct byte_ring*, uint8_t);
 	size_t									number_lines;
 	size_t									line_length;
-	uint8_t*								backing_store;
+	size_t									line_mask;
+	intptr_t								backing_store_offset;
 	size_t									backing_store_size;
-	size_t*									size_map;
+	size_t									backing_store_mapped_size;
+
+	// the size map holds one entry per line, each entry is only as wide as the line length needs
+	// the top bit of an entry is kept for line_committed, which br_commit_line sets in BR_CONCURRENT_MPSC
+	intptr_t								size_map_offset;
+	size_t									size_width;
+	size_t									line_committed;
+
+	// only with BR_PACKED_RECORDS, the byte counter each line starts at, a line is found at that counter modulo the store size
+	// the producer fills in the entry of a line before publishing the line with the write head
+	intptr_t								offset_map_offset;
+
+	// the heads are 64 bit line counters that only ever grow, a line is found from its head with br_get_line
+	// the read head is always behind the write head, by 1 when the ring is empty and number_lines - 1 when full
+
+	// owned by the producer
+	// cached_read is the last read head the producer saw, it is only reloaded when the ring looks full
+	// every producer claims lines by moving the write head in BR_CONCURRENT_MPSC
+	// with BR_BATCHED_PUBLISH the consumer goes by published instead, which catches up with the write head once per batch
+	// batch_lines are the lines written since, and batch_started is when the first of them was
+	// bytes_written less bytes_released is what the size map adds up to, see br_bytes_used
+	_Alignas(BR_CACHE_LINE_SIZE)
+	uint64_t								write;
+	uint64_t								cached_read;
+	uint32_t								producer_flags;
+	uint32_t								batch_lines;
+	uint64_t								published;
+	uint32_t								batch_limit;
+	uint64_t								batch_delay_ns;
+	uint64_t								batch_started;
+	uint64_t								bytes_written;
+
+	// only while the ring is in a selector, the producer raises the bit of selector_slot after it publishes lines
+	// like notify_fd this only means something in one process, so br_selector_add never takes a ring others can see
+	br_selector_t*					selector;
+	size_t									selector_slot;
+
+#	ifdef BR_STATS
+	br_producer_stats_t			producer_stats;
+#	endif
 
-	uint8_t*								write;
-	uint8_t*								read;
+	// owned by the consumer
+	// cached_write is the last write head the consumer saw, it is only reloaded when the ring looks empty
+	_Alignas(BR_CACHE_LINE_SIZE)
+	uint64_t								read;
+	uint64_t								cached_write;
+	uint32_t								consumer_flags;
+	uint32_t								spin_budget;
+	uint64_t								bytes_released;
+
+#	ifdef BR_STATS
+	br_consumer_stats_t			consumer_stats;
+#	endif
+
+	// only with BR_WAITABLE, the consumer raises waiting before it sleeps and a producer publishing a line clears it
+	// the producer reads waiting after every line it publishes, the consumer only writes it when it is about to sleep
+	// wake_sequence is the futex word, it moves every time a producer wakes the consumer
+	// notify_fd only means something in the process notify_pid, a ring in shared memory is seen by others too
+	_Alignas(BR_CACHE_LINE_SIZE)
+	uint32_t								waiting;
+	uint32_t								wake_sequence;
+	int											notify_fd;
+	pid_t										notify_pid;
 };
 
+// the distance from the struct to memory the ring uses, 0 stands for none
+inline static intptr_t br_get_distance(byte_ring_t* ring, const void* address)
+{
+	return ((NULL == address) ? 0 : ((intptr_t) address - (intptr_t) ring));
+}
+
+inline static void* br_at_distance(byte_ring_t* ring, intptr_t distance)
+{
+	return ((void*) ((intptr_t) ring + distance));
+}
+
+inline static void* br_get_size_map(byte_ring_t* ring)
+{
+	return (br_at_distance(ring, ring->size_map_offset));
+}
+
+inline static uint64_t* br_get_offset_map(byte_ring_t* ring)
+{
+	return ((uint64_t*) br_at_distance(ring, ring->offset_map_offset));
+}
+
+#ifdef __linux__
+// on disk in front of a ring made by br_create_mapped, see br_create_mapped_header
+#define BR_FILE_MAGIC						"BYTERING"
+#define BR_FILE_VERSION					3
+
+typedef struct br_file_header
+{
+	char										magic[8];
+	uint32_t								version;
+	uint32_t								struct_size;
+	uint32_t								cache_line_size;
+	uint32_t								behavior_flags;
+	uint64_t								file_size;
+	uint64_t								number_lines;
+	uint64_t								line_length;
+
+	// 1 once br_destroy wrote everything back, 0 while the file is in use
+	uint32_t								clean;
+} br_file_header_t;
+
+// keeps the ring behind the header on a cache line, like br_create_in_place needs
+inline static size_t br_get_file_header_size(void)
+{
+	return ((sizeof(br_file_header_t) + BR_CACHE_LINE_SIZE - 1) / BR_CACHE_LINE_SIZE * BR_CACHE_LINE_SIZE);
+}
+
+inline static br_file_header_t* br_get_file_header(byte_ring_t* ring)
+{
+	return ((br_file_header_t*) ((uint8_t*) ring - br_get_file_header_size()));
+}
+#endif
+
+// the producer and the consumer both raise event flags, so the flags are only touched atomically
+// each side raises its events in its own word, reading the flags merges all of them
+inline static uint32_t _br_load_flags(const uint32_t* flags)
+{
+	return (__atomic_load_n(flags, __ATOMIC_RELAXED));
+}
+
+inline static void _br_raise_flags(uint32_t* flags, uint32_t raised)
+{
+	// event flags are sticky, only pay for the read-modify-write when something new is raised
+	if(raised != (_br_load_flags(flags) & raised))
+	{
+		__atomic_fetch_or(flags, raised, __ATOMIC_RELAXED);
+	}
+}
+
 inline static uint32_t _br_get_flags(byte_ring_t* ring)
 {
-	return (ring->bit_flags);
+	return (_br_load_flags(&(ring->bit_flags))
+		| _br_load_flags(&(ring->producer_flags))
+		| _br_load_flags(&(ring->consumer_flags)));
+}
+
+// only the allocation and behavior flags, without touching either side's cache line
+inline static uint32_t _br_get_immutable_flags(byte_ring_t* ring)
+{
+	return (_br_load_flags(&(ring->bit_flags)) & BR_IMMUTABLE_FLAGS_MASK);
 }
 
 inline static void _br_set_flags(byte_ring_t* ring, uint32_t flags)
 {
-	ring->bit_flags = flags;
+	__atomic_store_n(&(ring->bit_flags), flags, __ATOMIC_RELAXED);
 }
 
 inline static void _br_add_flags(byte_ring_t* ring, uint32_t flags)
 {
-	ring->bit_flags |= flags;
+	_br_raise_flags(&(ring->bit_flags), flags);
+}
+
+inline static void _br_add_producer_flags(byte_ring_t* ring, uint32_t flags)
+{
+	_br_raise_flags(&(ring->producer_flags), flags);
+}
+
+inline static void _br_add_consumer_flags(byte_ring_t* ring, uint32_t flags)
+{
+	_br_raise_flags(&(ring->consumer_flags), flags);
 }
 
 inline static void _br_clear_flag(byte_ring_t* ring, uint32_t flag)
 {
-	uint32_t flags = _br_get_flags(ring) & ~(flag);
-	_br_set_flags(ring, flags);
+	__atomic_fetch_and(&(ring->bit_flags), ~(flag), __ATOMIC_RELAXED);
+	__atomic_fetch_and(&(ring->producer_flags), ~(flag), __ATOMIC_RELAXED);
+	__atomic_fetch_and(&(ring->consumer_flags), ~(flag), __ATOMIC_RELAXED);
 }
 
 inline static void _br_clear_event_flags(byte_ring_t* ring)
 {
-	uint32_t flags = _br_get_flags(ring) & BR_IMMUTABLE_FLAGS_MASK;
+	uint32_t flags = _br_get_immutable_flags(ring);
 	_br_set_flags(ring, flags);
+	__atomic_store_n(&(ring->producer_flags), 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&(ring->consumer_flags), 0, __ATOMIC_RELAXED);
 }
 
 inline static bool _br_flag_is_set(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
@@ -66,666 +324,3154 @@ inline static bool _br_flag_is_set(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
 	return (0 != (_br_get_flags(ring) & event_flag));
 }
 
-inline static size_t br_get_backing_store_size(byte_ring_t* ring)
+// in BR_CONCURRENT_SPSC the producer owns the write head and the consumer owns the read head
+// a head is published with release after its line is complete, and the other side loads it with acquire
+// on x86 both compile to plain moves, so every ring goes through these
+inline static uint64_t br_load_head(const uint64_t* head)
 {
-	return (ring->backing_store_size);
+	return (__atomic_load_n(head, __ATOMIC_ACQUIRE));
 }
 
-inline static uint8_t* br_get_first_line(byte_ring_t* ring)
+inline static void br_store_head(uint64_t* head, uint64_t line)
 {
-	return (ring->backing_store);
+	__atomic_store_n(head, line, __ATOMIC_RELEASE);
 }
 
-inline static uint8_t* br_get_final_line(byte_ring_t* ring)
+// BR_CONCURRENT_SPSC leaves the read head to the consumer, so the producer may not overwrite the oldest line
+// BR_CONCURRENT_MPSC producers cannot overwrite a line another producer has claimed, so they can only refuse
+inline static bool br_behavior_is_supported(uint32_t behavior_flag)
 {
-	// take the first line, go to the last byte, move back by a line's length
-	return (br_get_first_line(ring) + br_get_backing_store_size(ring) - (ring->line_length));
+	uint32_t concurrent	= behavior_flag & BR_CONCURRENT_FLAGS_MASK;
+	uint32_t overwrite	= behavior_flag & BR_OVERWRITE_FLAGS_MASK;
+	bool function_value	= true;
+
+	if((BR_CONCURRENT_SPSC == concurrent) && (BR_OVERWRITE_OLDEST == overwrite)) { function_value = false; }
+	if((BR_CONCURRENT_MPSC == concurrent) && (BR_OVERWRITE_REFUSAL != overwrite)) { function_value = false; }
+	if(BR_CONCURRENT_FLAGS_MASK == concurrent) { function_value = false; }
+
+	// every producer publishes its own lines with br_commit_line, there is no write head to hold back
+	if((BR_CONCURRENT_MPSC == concurrent) && (0 != (behavior_flag & BR_BATCHED_PUBLISH))) { function_value = false; }
+
+#	ifndef __linux__
+	if(0 != (behavior_flag & BR_MIRRORED_STORE)) { function_value = false; }
+	if(0 != (behavior_flag & BR_WAITABLE)) { function_value = false; }
+#	endif
+
+	return (function_value);
 }
 
-inline static uint8_t* br_get_specific_line(byte_ring_t* ring, size_t index)
+inline static bool br_is_multi_producer(byte_ring_t* ring)
 {
-	return (br_get_first_line(ring) + (index * ring->line_length));
+	return (0 != (_br_get_immutable_flags(ring) & BR_CONCURRENT_MPSC));
 }
 
-inline static size_t br_get_line_index(byte_ring_t* ring, uint8_t* head)
+inline static bool br_is_batched(byte_ring_t* ring)
 {
-	return ((size_t) (head - br_get_first_line(ring)));
+	return (0 != (_br_get_immutable_flags(ring) & BR_BATCHED_PUBLISH));
 }
 
-inline static uint8_t* br_get_next_line(byte_ring_t* ring, uint8_t* head)
+inline static uint64_t br_get_monotonic_ns(void)
 {
-	const uint8_t* final = br_get_final_line(ring);
-	uint8_t* function_value = NULL;
-	
-	// if this line is at the end, go back to the beginning
-	if(final == head) { function_value = br_get_first_line(ring); }
-		
-	// if this line is not at the end, move forward by a line length from where it currently is
-	if(final != head) {	function_value = head + ring->line_length; }
-	
-	return (function_value);
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec);
 }
 
-inline static size_t br_get_size(byte_ring_t* ring, uint8_t* head)
+inline static bool br_is_packed(byte_ring_t* ring)
 {
-	size_t index = br_get_line_index(ring, head);
-	return ((ring->size_map)[index]);
+	return (0 != (_br_get_immutable_flags(ring) & BR_PACKED_RECORDS));
 }
 
-inline static void br_set_size(byte_ring_t* ring, size_t index, size_t size)
+inline static bool br_is_mirrored(byte_ring_t* ring)
 {
-	(ring->size_map)[index] = size;
+	return (0 != (_br_get_immutable_flags(ring) & BR_MIRRORED_STORE));
 }
 
-inline static bool br_write_line_is_full(byte_ring_t* ring)
+inline static bool br_is_power_of_two(size_t value)
 {
-	bool function_value = false;
-	if(ring->line_length <= br_get_size(ring, ring->write))
-	{
-		function_value = true;
-		_br_add_flags(ring, BR_FLAG_LINE_WRAPPED);
-	}
-	
-	return (function_value);
+	return ((0 != value) && (0 == (value & (value - 1))));
 }
 
-inline static bool br_head1_will_point_to_head2(byte_ring_t* ring, uint8_t* restrict head1, uint8_t* restrict head2)
+// the narrowest size map entry that holds any line length next to the committed bit
+inline static size_t br_get_size_width(size_t len_lines)
 {
-	bool function_value = false;
-	if(br_get_next_line(ring, head1) == head2) { function_value = true; }
+	size_t function_value = sizeof(uint64_t);
+	if(len_lines <= (UINT32_MAX >> 1))	{ function_value = sizeof(uint32_t); }
+	if(len_lines <= (UINT16_MAX >> 1))	{ function_value = sizeof(uint16_t); }
+	if(len_lines <= (UINT8_MAX >> 1))		{ function_value = sizeof(uint8_t); }
 	return (function_value);
 }
 
-// if this function returns true, the byte_ring is full
-inline static bool br_write_will_point_to_read(byte_ring_t* ring)
+inline static size_t br_get_size_map_size(size_t n_lines, size_t len_lines)
 {
-	bool clobber = br_head1_will_point_to_head2(ring, ring->write, ring->read);
-	if(true == clobber) { _br_add_flags(ring, BR_FLAG_RING_FULL); }
-	return (clobber);
+	return (n_lines * br_get_size_width(len_lines));
 }
 
-// if this function returns true, the byte_ring is empty
-inline static bool br_read_will_point_to_write(byte_ring_t* ring)
+// number_lines - 1 when a head counter can be masked into a slot, 0 when it has to be divided
+inline static size_t br_get_line_mask(size_t n_lines)
 {
-	bool clobber = br_head1_will_point_to_head2(ring, ring->read, ring->write);
-	if(true == clobber) { _br_add_flags(ring, BR_FLAG_RING_EMPTY); }
-	return (clobber);
+	return ((true == br_is_power_of_two(n_lines)) ? (n_lines - 1) : 0);
 }
 
-static void br_check_truths(byte_ring_t* ring)
+// records the geometry, the way a head counter becomes a slot is decided here once, by line_mask
+inline static void br_set_geometry(byte_ring_t* ring, size_t n_lines, size_t len_lines)
 {
-	#ifdef BR_ASSERT_ACTIVE
-	assert(NULL != ring);
-	assert(NULL != ring->backing_store);
-	assert(NULL != ring->size_map);
-	assert(NULL != ring->write);
-	assert(NULL != ring->read);
-	assert(NULL != ring->push_function);
-	assert(0		!= br_get_backing_store_size(ring));
-	assert(0 == (ring->read == ring->write));
-	#endif
-	
-	#ifndef BR_ASSERT_ACTIVE
-	#endif
+	ring->size_width					= br_get_size_width(len_lines);
+	ring->line_committed			= ((size_t) 1) << (ring->size_width * 8 - 1);
+
+	ring->backing_store_size	= n_lines * len_lines;
+	ring->number_lines				= n_lines;
+	ring->line_length					= len_lines;
+	ring->line_mask						= br_get_line_mask(n_lines);
 }
 
-inline static void br_reset_write_head(byte_ring_t* ring)
+inline static size_t br_get_backing_store_size(byte_ring_t* ring)
 {
-	size_t index = br_get_line_index(ring, ring->write);
-	br_set_size(ring, index, 0);
+	return (ring->backing_store_size);
 }
 
-inline static void br_reset_read_head(byte_ring_t* ring)
+inline static uint8_t* br_get_first_line(byte_ring_t* ring)
 {
-	size_t index = br_get_line_index(ring, ring->read);
-	br_set_size(ring, index, 0);
-	
-#	ifdef BR_SHRED_OLD_DATA
-	// really unnecessary to do thrice, but that assumes this data structures goes into volatile memory
-	// instead of someone's hacked up non-volatile memory mappings
-	// but also dealing with swap files that might get thrown onto a disk temporarily
-	memset(ring->read, 0xA5, ring->line_length * sizeof(uint8_t));
-	memset(ring->read, 0x5A, ring->line_length * sizeof(uint8_t));
-	memset(ring->read, 0, ring->line_length * sizeof(uint8_t));
-#	endif
+	return ((uint8_t*) br_at_distance(ring, ring->backing_store_offset));
 }
 
-inline static void br_write_byte(byte_ring_t* ring, uint8_t byte)
+inline static uint8_t* br_get_final_line(byte_ring_t* ring)
 {
-	size_t size = br_get_size(ring, ring->write);
-	size_t index = br_get_line_index(ring, ring->write);
-	
-	*(ring->write + size) = byte;
-	
-	br_set_size(ring, index, size + sizeof(byte));
+	// take the first line, go to the last byte, move back by a line's length
+	return (br_get_first_line(ring) + br_get_backing_store_size(ring) - (ring->line_length));
 }
 
-inline static void br_move_read_line_forward(byte_ring_t* ring)
+inline static uint8_t* br_get_specific_line(byte_ring_t* ring, size_t index)
 {
-	br_reset_read_head(ring);
-	ring->read = br_get_next_line(ring, ring->read);
-	br_check_truths(ring);
+	return (br_get_first_line(ring) + (index * ring->line_length));
 }
 
-inline static void br_move_write_line_forward(byte_ring_t* ring)
+inline static size_t br_get_line_index(byte_ring_t* ring, uint8_t* line)
 {
-	// store the size of the written data into the size map
-	// before moving to the next line
-	size_t index = br_get_line_index(ring, ring->write);
-	br_set_size(ring, index, br_peek_write_size(ring));
+	// the size map is indexed by line, not by byte offset into the backing store
+	return ((size_t) (line - br_get_first_line(ring)) / ring->line_length);
+}
 
-	ring->write = br_get_next_line(ring, ring->write);
-	br_reset_write_head(ring);
-	br_check_truths(ring);
+// the size map slot of the line a head counter is on
+// only reads the geometry, the flags are not loaded, and a ring always goes the same way
+inline static size_t br_get_slot(byte_ring_t* ring, uint64_t head)
+{
+	return ((0 != ring->line_mask) ? (size_t) (head & ring->line_mask) : (size_t) (head % ring->number_lines));
 }
 
-inline static void br_increment_write(byte_ring_t* ring, bool force)
+// the line a head counter is on, a multiply is as cheap as a shift, so the line length needs no power of two
+// only packed rings have an offset map, which the create functions set up
+inline static uint8_t* br_get_line(byte_ring_t* ring, uint64_t head)
 {
-	bool clobber = br_read_will_point_to_write(ring);
-	if(true == clobber && false == force) { goto function_exit; }
-	if(true == clobber) { br_move_read_line_forward(ring); }
-	br_move_write_line_forward(ring);
-function_exit:
-	br_check_truths(ring);
+	size_t slot = br_get_slot(ring, head);
+	uint8_t* function_value = br_get_specific_line(ring, slot);
+
+	if(0 != ring->offset_map_offset)
+	{
+		function_value = br_get_first_line(ring) + (size_t) (br_get_offset_map(ring)[slot] % br_get_backing_store_size(ring));
+	}
+
+	return (function_value);
 }
 
-inline static void br_increment_read(byte_ring_t* ring, bool force)
+// only used to walk the backing store in order, the heads never wrap
+inline static uint8_t* br_get_next_line(byte_ring_t* ring, uint8_t* line)
 {
-	bool clobber = br_read_will_point_to_write(ring);
-	if(true == clobber && false == force) { goto function_exit; }
-	if(true == clobber) { br_move_write_line_forward(ring); }
-	br_move_read_line_forward(ring);
-function_exit:
-	br_check_truths(ring);
+	const uint8_t* final = br_get_final_line(ring);
+	uint8_t* function_value = NULL;
+	
+	// if this line is at the end, go back to the beginning
+	if(final == line) { function_value = br_get_first_line(ring); }
+		
+	// if this line is not at the end, move forward by a line length from where it currently is
+	if(final != line) {	function_value = line + ring->line_length; }
+	
+	return (function_value);
 }
 
-// return true == push_success, always returns true
-static bool br_push_overwrite_oldest(byte_ring_t* ring, uint8_t byte)
+// the width only depends on the geometry, so the switches below always take the same branch for a ring
+// a size map that is not part of a ring yet, br_open_mapped checks one before it writes anything into the file
+inline static size_t br_get_size_entry_at(const void* size_map, size_t size_width, size_t index)
 {
-	bool clobber		= br_write_will_point_to_read(ring);
-	bool full				=	br_write_line_is_full(ring);
-	bool overwrite	= clobber && full;
+	size_t function_value = 0;
 
-	if(true == overwrite)
+	switch(size_width)
 	{
-		br_move_read_line_forward(ring);
-		_br_add_flags(ring, BR_FLAG_OVERWRITE);
+		case sizeof(uint8_t):		function_value = ((const uint8_t*) size_map)[index];	break;
+		case sizeof(uint16_t):	function_value = ((const uint16_t*) size_map)[index];	break;
+		case sizeof(uint32_t):	function_value = ((const uint32_t*) size_map)[index];	break;
+		default:								function_value = ((const uint64_t*) size_map)[index];	break;
 	}
 
-	if(true == full)
+	return (function_value);
+}
+
+inline static size_t br_get_size_entry(byte_ring_t* ring, size_t index)
+{
+	return (br_get_size_entry_at(br_get_size_map(ring), ring->size_width, index));
+}
+
+inline static void br_set_size(byte_ring_t* ring, size_t index, size_t size)
+{
+	switch(ring->size_width)
 	{
-		br_move_write_line_forward(ring);
+		case sizeof(uint8_t):		((uint8_t*) br_get_size_map(ring))[index] = (uint8_t) size;		break;
+		case sizeof(uint16_t):	((uint16_t*) br_get_size_map(ring))[index] = (uint16_t) size;	break;
+		case sizeof(uint32_t):	((uint32_t*) br_get_size_map(ring))[index] = (uint32_t) size;	break;
+		default:								((uint64_t*) br_get_size_map(ring))[index] = (uint64_t) size;	break;
 	}
-
-	br_write_byte(ring, byte);
-	br_check_truths(ring);
-	return (true);
 }
 
-// return true == push_success, always returns true
-static bool br_push_overwrite_newest(byte_ring_t* ring, uint8_t byte)
+// the entry for a line handed over between threads, loaded with acquire
+inline static size_t br_load_size_entry(byte_ring_t* ring, size_t index)
 {
-	bool clobber		= br_write_will_point_to_read(ring);
-	bool full				=	br_write_line_is_full(ring);
-	bool overwrite	= clobber && full;
+	size_t function_value = 0;
 
-	if(true == overwrite)
+	switch(ring->size_width)
 	{
-		br_reset_write_head(ring);
-		_br_add_flags(ring, BR_FLAG_OVERWRITE);
+		case sizeof(uint8_t):		function_value = __atomic_load_n(((uint8_t*) br_get_size_map(ring)) + index, __ATOMIC_ACQUIRE);	break;
+		case sizeof(uint16_t):	function_value = __atomic_load_n(((uint16_t*) br_get_size_map(ring)) + index, __ATOMIC_ACQUIRE);	break;
+		case sizeof(uint32_t):	function_value = __atomic_load_n(((uint32_t*) br_get_size_map(ring)) + index, __ATOMIC_ACQUIRE);	break;
+		default:								function_value = __atomic_load_n(((uint64_t*) br_get_size_map(ring)) + index, __ATOMIC_ACQUIRE);	break;
 	}
 
-	if((false == overwrite) && (true == full))
+	return (function_value);
+}
+
+// the entry for a line handed over between threads, stored with release
+inline static void br_store_size_entry(byte_ring_t* ring, size_t index, size_t size)
+{
+	switch(ring->size_width)
 	{
-		br_move_write_line_forward(ring);
+		case sizeof(uint8_t):		__atomic_store_n(((uint8_t*) br_get_size_map(ring)) + index, (uint8_t) size, __ATOMIC_RELEASE);		break;
+		case sizeof(uint16_t):	__atomic_store_n(((uint16_t*) br_get_size_map(ring)) + index, (uint16_t) size, __ATOMIC_RELEASE);	break;
+		case sizeof(uint32_t):	__atomic_store_n(((uint32_t*) br_get_size_map(ring)) + index, (uint32_t) size, __ATOMIC_RELEASE);	break;
+		default:								__atomic_store_n(((uint64_t*) br_get_size_map(ring)) + index, (uint64_t) size, __ATOMIC_RELEASE);	break;
 	}
+}
 
-	br_write_byte(ring, byte);
-	br_check_truths(ring);
-	return (true);
+inline static size_t br_get_size(byte_ring_t* ring, uint64_t head)
+{
+	size_t slot = br_get_slot(ring, head);
+	return (br_get_size_entry(ring, slot) & ~(ring->line_committed));
 }
 
-// returns true == push_success, when ring was not full
-// returns false == no mutation, when ring was full
-static bool br_push_refuse_overwrite(byte_ring_t* ring, uint8_t byte)
+inline static bool br_line_is_committed(byte_ring_t* ring, uint64_t head)
 {
-	bool clobber				= br_write_will_point_to_read(ring);
-	bool full						=	br_write_line_is_full(ring);
-	bool overwrite			= clobber && full;
+	size_t slot = br_get_slot(ring, head);
+	return (0 != (br_load_size_entry(ring, slot) & ring->line_committed));
+}
 
-	if(true == overwrite)
-	{
-		goto fail_early;
-	}
-		
-	if(true == full)
-	{
-		br_move_write_line_forward(ring);
-	}
-	
-	br_write_byte(ring, byte);
-fail_early:
-	br_check_truths(ring);
-	return (false == overwrite);
+// the byte counter the line after the write line starts at in BR_PACKED_RECORDS
+// a line never wraps around the end of the backing store, so when a whole line would not fit before the end the rest is skipped
+// unless the store is mirrored, then a line runs on into the second mapping
+inline static uint64_t br_get_offset_after(byte_ring_t* ring, uint64_t offset, size_t size)
+{
+	offset += size;
+	size_t tail = br_get_backing_store_size(ring) - (size_t) (offset % br_get_backing_store_size(ring));
+
+	// a mirrored backing store continues past its end, so nothing needs skipping
+	if((tail < ring->line_length) && (false == br_is_mirrored(ring))) { offset += tail; }
+	return (offset);
 }
 
-byte_ring_t* br_create_full_alloc(size_t n_lines, size_t len_lines,
-		BR_BEHAVIOR_FLAGS behavior_flag)
+inline static uint64_t br_get_next_offset(byte_ring_t* ring)
 {
-	size_t size								= len_lines * n_lines;
-	byte_ring_t* ring					= (byte_ring_t*) malloc(sizeof(byte_ring_t));
-	if(NULL == ring) { goto fail_early; }
+	uint64_t offset = br_get_offset_map(ring)[br_get_slot(ring, ring->write)];
+	return (br_get_offset_after(ring, offset, br_get_size(ring, ring->write)));
+}
 
-	uint8_t* backing_store		= (uint8_t*) malloc(size);
-	if(NULL == backing_store)
+// with BR_PACKED_RECORDS the next line also needs a whole line length of the backing store, counted from the read line
+// that way the write line always has room to fill up, no matter how full the ring is in bytes
+// line is the write line, or a line br_fill_from_fd is planning to write, and next_offset where the line after it starts
+inline static bool br_ring_is_full_after(byte_ring_t* ring, uint64_t read, uint64_t line, uint64_t next_offset)
+{
+	bool function_value = (ring->number_lines - 1 <= line - read);
+	if((false == function_value) && (true == br_is_packed(ring)))
 	{
-		free(ring);
-		ring = NULL;
-		goto fail_early;
+		uint64_t oldest = br_get_offset_map(ring)[br_get_slot(ring, read)];
+		function_value = (br_get_backing_store_size(ring) < next_offset + ring->line_length - oldest);
 	}
 
-	size_t* size_map					= (size_t*) malloc(sizeof(size_t) * n_lines);
-	if(NULL == size_map)
-	{
-		free(ring);
-		free(backing_store);
+	return (function_value);
+}
+
+// judged from cached_read, see br_write_will_point_to_read
+inline static bool br_ring_looks_full_after(byte_ring_t* ring, uint64_t line, uint64_t next_offset)
+{
+	return (br_ring_is_full_after(ring, ring->cached_read, line, next_offset));
+}
+
+inline static bool br_ring_looks_full(byte_ring_t* ring)
+{
+	uint64_t next_offset = (true == br_is_packed(ring)) ? br_get_next_offset(ring) : 0;
+	return (br_ring_looks_full_after(ring, ring->write, next_offset));
+}
+
+inline static bool br_write_line_is_full(byte_ring_t* ring)
+{
+	bool function_value = false;
+	if(ring->line_length <= br_get_size(ring, ring->write))
+	{
+		function_value = true;
+		_br_add_producer_flags(ring, BR_FLAG_LINE_WRAPPED);
+	}
+	
+	return (function_value);
+}
+
+// the counters of BR_STATS, every br_stats_* function compiles to nothing without it
+// a side adds to its own counters with a plain load and store, several producers share theirs and add atomically
+#ifdef BR_STATS
+inline static void br_stats_add(uint64_t* counter, uint64_t n, bool shared)
+{
+	if(true == shared)	{ __atomic_fetch_add(counter, n, __ATOMIC_RELAXED); }
+	else								{ __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED); }
+}
+
+inline static void br_stats_raise(uint64_t* high_water, uint64_t lines)
+{
+	uint64_t seen = __atomic_load_n(high_water, __ATOMIC_RELAXED);
+	while((seen < lines) && (false == __atomic_compare_exchange_n(high_water, &seen, lines,
+		true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))) { }
+}
+#endif
+
+inline static void br_stats_count_pushed(byte_ring_t* ring, size_t bytes)
+{
+#	ifdef BR_STATS
+	br_stats_add(&(ring->producer_stats.bytes_pushed), bytes, br_is_multi_producer(ring));
+#	endif
+	(void) ring;
+	(void) bytes;
+}
+
+inline static void br_stats_count_published(byte_ring_t* ring, size_t size)
+{
+#	ifdef BR_STATS
+	bool shared = br_is_multi_producer(ring);
+	size_t bucket = (size * BR_STATS_FILL_BUCKETS) / (ring->line_length + 1);
+	br_stats_add(&(ring->producer_stats.lines_pushed), 1, shared);
+	br_stats_add(&(ring->producer_stats.fill_histogram[bucket]), 1, shared);
+#	endif
+	(void) ring;
+	(void) size;
+}
+
+inline static void br_stats_count_overwrite(byte_ring_t* ring, uint32_t behavior)
+{
+#	ifdef BR_STATS
+	uint64_t* counter = (BR_OVERWRITE_OLDEST == behavior)
+		? &(ring->producer_stats.overwrites_oldest) : &(ring->producer_stats.overwrites_newest);
+	br_stats_add(counter, 1, false);
+#	endif
+	(void) ring;
+	(void) behavior;
+}
+
+inline static void br_stats_count_refusal(byte_ring_t* ring)
+{
+#	ifdef BR_STATS
+	br_stats_add(&(ring->producer_stats.refusals), 1, br_is_multi_producer(ring));
+#	endif
+	(void) ring;
+}
+
+inline static void br_stats_count_popped(byte_ring_t* ring, size_t lines)
+{
+#	ifdef BR_STATS
+	br_stats_add(&(ring->consumer_stats.lines_popped), lines, false);
+#	endif
+	(void) ring;
+	(void) lines;
+}
+
+inline static void br_stats_count_truncation(byte_ring_t* ring)
+{
+#	ifdef BR_STATS
+	br_stats_add(&(ring->consumer_stats.truncations), 1, false);
+#	endif
+	(void) ring;
+}
+
+// lines is how many were waiting right when a side loaded the other side's head
+inline static void br_stats_count_waiting(byte_ring_t* ring, uint64_t lines, bool producer)
+{
+#	ifdef BR_STATS
+	br_stats_raise((true == producer)
+		? &(ring->producer_stats.high_water_lines) : &(ring->consumer_stats.high_water_lines), lines);
+#	endif
+	(void) ring;
+	(void) lines;
+	(void) producer;
+}
+
+// with BR_TRACE every tracepoint costs a load and a branch while no hook is set, without it br_trace is empty
+#ifdef BR_TRACE
+static br_trace_hook br_trace_installed = NULL;
+
+void br_set_trace_hook(br_trace_hook hook)
+{
+	__atomic_store_n(&br_trace_installed, hook, __ATOMIC_RELEASE);
+}
+#endif
+
+inline static void br_trace(byte_ring_t* ring, BR_TRACE_EVENT event, uint64_t head, size_t size)
+{
+#	ifdef BR_TRACE
+	br_trace_hook hook = __atomic_load_n(&br_trace_installed, __ATOMIC_ACQUIRE);
+	if(NULL != hook) { hook(event, ring, br_get_slot(ring, head), size); }
+#	endif
+	(void) ring;
+	(void) event;
+	(void) head;
+	(void) size;
+}
+
+// the producer counts every byte that lands in a line, and takes back the ones a BR_OVERWRITE_NEWEST ring throws away
+// the consumer counts every byte of a line it releases, so neither side writes the other's counter
+inline static void br_count_written(byte_ring_t* ring, uint64_t bytes)
+{
+	if(true == br_is_multi_producer(ring))	{ __atomic_fetch_add(&(ring->bytes_written), bytes, __ATOMIC_RELEASE); }
+	else																		{ __atomic_store_n(&(ring->bytes_written), ring->bytes_written + bytes, __ATOMIC_RELEASE); }
+}
+
+inline static void br_count_released(byte_ring_t* ring, uint64_t bytes)
+{
+	__atomic_store_n(&(ring->bytes_released), ring->bytes_released + bytes, __ATOMIC_RELEASE);
+}
+
+// a ring built in memory the caller handed over may be mapped by other processes, see br_attach
+inline static bool br_is_shareable(byte_ring_t* ring)
+{
+	return (0 == (_br_get_immutable_flags(ring) & BR_ALLOC_FLAGS_MASK & ~BR_FILE_MAPPED));
+}
+
+#ifdef __linux__
+// the private futex ops are cheaper, but only wake waiters in the same process
+inline static int br_get_futex_op(byte_ring_t* ring, int op)
+{
+	return ((true == br_is_shareable(ring)) ? op : (op | FUTEX_PRIVATE_FLAG));
+}
+
+// kept out of line, the producer only gets here when the consumer is asleep
+__attribute__((noinline))
+static void br_wake_consumer(byte_ring_t* ring)
+{
+	// with several producers only the first one to see the consumer waiting wakes it
+	uint32_t waiting = __atomic_exchange_n(&(ring->waiting), 0, __ATOMIC_ACQ_REL);
+
+	if(0 != (waiting & BR_WAITING_FUTEX))
+	{
+		__atomic_fetch_add(&(ring->wake_sequence), 1, __ATOMIC_RELEASE);
+		syscall(SYS_futex, &(ring->wake_sequence), br_get_futex_op(ring, FUTEX_WAKE), 1, NULL, NULL, 0);
+	}
+
+	// the fd is not open in any other process, a consumer there waits on the futex
+	if((0 != (waiting & BR_WAITING_FD)) && (getpid() == ring->notify_pid))
+	{
+		uint64_t one = 1;
+		ssize_t written = write(ring->notify_fd, &one, sizeof(one));
+		(void) written;
+	}
+}
+#endif
+
+static void br_selector_raise(br_selector_t* selector, size_t slot);
+
+// called after a line has been published to the consumer
+// the fence orders the publish before reading waiting and the selector's bit
+// the consumer orders raising waiting before its last look, and lowering the bit before looking at the ring
+inline static void br_notify_consumer(byte_ring_t* ring)
+{
+	br_selector_t* selector = __atomic_load_n(&(ring->selector), __ATOMIC_ACQUIRE);
+	bool waitable = false;
+
+#	ifdef __linux__
+	waitable = (0 != (_br_get_immutable_flags(ring) & BR_WAITABLE));
+#	endif
+
+	if((NULL == selector) && (false == waitable)) { goto function_exit; }
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(NULL != selector) { br_selector_raise(selector, __atomic_load_n(&(ring->selector_slot), __ATOMIC_RELAXED)); }
+
+#	ifdef __linux__
+	if((true == waitable) && (0 != __atomic_load_n(&(ring->waiting), __ATOMIC_RELAXED))) { br_wake_consumer(ring); }
+#	endif
+
+function_exit:
+	return;
+}
+
+// makes every line written so far visible to the consumer at once, with one release and at most one wakeup
+inline static bool br_publish(byte_ring_t* ring)
+{
+	bool function_value = (ring->published != ring->write);
+	if(false == function_value) { goto function_exit; }
+
+	br_store_head(&(ring->published), ring->write);
+	ring->batch_lines = 0;
+	br_notify_consumer(ring);
+
+function_exit:
+	return (function_value);
+}
+
+// a line was just written to a BR_BATCHED_PUBLISH ring, the batch goes out when it is big or old enough
+inline static void br_count_batched_line(byte_ring_t* ring)
+{
+	ring->batch_lines += 1;
+	if(ring->batch_limit <= ring->batch_lines) { br_publish(ring); goto function_exit; }
+	if(0 == ring->batch_delay_ns) { goto function_exit; }
+
+	uint64_t now = br_get_monotonic_ns();
+	if(1 == ring->batch_lines) { ring->batch_started = now; }
+	if(ring->batch_delay_ns <= now - ring->batch_started) { br_publish(ring); }
+
+function_exit:
+	return;
+}
+
+// if this function returns true, the byte_ring is full
+// the read head only grows, so a stale cached_read can only make the ring look full when it is not
+// the shared read head is loaded again only in that case
+inline static bool br_write_will_point_to_read(byte_ring_t* ring)
+{
+	bool clobber = br_ring_looks_full(ring);
+	if(true == clobber)
+	{
+		// the consumer can only make room with the lines it has been shown
+		if(true == br_is_batched(ring)) { br_publish(ring); }
+		ring->cached_read = br_load_head(&(ring->read));
+		clobber = br_ring_looks_full(ring);
+		br_stats_count_waiting(ring, ring->write - ring->cached_read - 1, true);
+	}
+
+	if(true == clobber) { _br_add_producer_flags(ring, BR_FLAG_RING_FULL); }
+	return (clobber);
+}
+
+// the head the consumer reads up to
+inline static uint64_t* br_get_published_head(byte_ring_t* ring)
+{
+	return ((true == br_is_batched(ring)) ? &(ring->published) : &(ring->write));
+}
+
+// if this function returns true, nothing can be read past head, which is at or ahead of the read head
+// same as above, a stale cached_write can only make the ring look empty when it is not
+// the difference is signed, BR_OVERWRITE_OLDEST can move the read head past the consumer's cached_write
+// with several producers the write head only counts claims, the next line is ready once it has been committed
+inline static bool br_line_is_last(byte_ring_t* ring, uint64_t head)
+{
+	bool clobber = ((int64_t) (ring->cached_write - head) <= 1);
+	if(true == br_is_multi_producer(ring))
+	{
+		clobber = (false == br_line_is_committed(ring, head + 1));
+	}
+	else if(true == clobber)
+	{
+		ring->cached_write = br_load_head(br_get_published_head(ring));
+		clobber = ((int64_t) (ring->cached_write - head) <= 1);
+		br_stats_count_waiting(ring, ring->cached_write - ring->read - 1, false);
+	}
+
+	return (clobber);
+}
+
+// if this function returns true, the byte_ring is empty
+inline static bool br_read_will_point_to_write(byte_ring_t* ring)
+{
+	bool clobber = br_line_is_last(ring, ring->read);
+	if(true == clobber) { _br_add_consumer_flags(ring, BR_FLAG_RING_EMPTY); }
+	return (clobber);
+}
+
+static void br_check_truths(byte_ring_t* ring)
+{
+	#ifdef BR_ASSERT_ACTIVE
+	assert(NULL != ring);
+	assert(0 != ring->backing_store_offset);
+	assert(0 != ring->size_map_offset);
+	assert((false == br_is_packed(ring)) || (0 != ring->offset_map_offset));
+	assert(0		!= br_get_backing_store_size(ring));
+	assert(br_load_head(&(ring->read)) != br_load_head(&(ring->write)));
+	#endif
+	
+	#ifndef BR_ASSERT_ACTIVE
+	#endif
+}
+
+inline static void br_reset_write_head(byte_ring_t* ring)
+{
+	size_t index = br_get_slot(ring, ring->write);
+	br_count_written(ring, 0 - (uint64_t) br_get_size(ring, ring->write));
+	br_set_size(ring, index, 0);
+}
+
+inline static void br_reset_read_line(byte_ring_t* ring, uint64_t head)
+{
+	size_t index = br_get_slot(ring, head);
+	
+#	ifdef BR_SHRED_OLD_DATA
+	// really unnecessary to do thrice, but that assumes this data structures goes into volatile memory
+	// instead of someone's hacked up non-volatile memory mappings
+	// but also dealing with swap files that might get thrown onto a disk temporarily
+	// packed lines only own the bytes they hold, the next line may already start right after them
+	uint8_t* line = br_get_line(ring, head);
+	size_t shred = ring->line_length;
+	if(true == br_is_packed(ring)) { shred = br_get_size(ring, head); }
+	memset(line, 0xA5, shred * sizeof(uint8_t));
+	memset(line, 0x5A, shred * sizeof(uint8_t));
+	memset(line, 0, shred * sizeof(uint8_t));
+#	endif
+
+	br_count_released(ring, br_get_size(ring, head));
+	br_set_size(ring, index, 0);
+}
+
+inline static void br_reset_read_head(byte_ring_t* ring)
+{
+	br_reset_read_line(ring, ring->read);
+}
+
+inline static void br_write_byte(byte_ring_t* ring, uint8_t byte)
+{
+	size_t index = br_get_slot(ring, ring->write);
+	size_t size = br_get_size_entry(ring, index);
+	
+	*(br_get_line(ring, ring->write) + size) = byte;
+	
+	br_set_size(ring, index, size + sizeof(byte));
+	br_count_written(ring, sizeof(byte));
+	br_stats_count_pushed(ring, sizeof(byte));
+}
+
+inline static void br_move_read_line_forward(byte_ring_t* ring)
+{
+	br_reset_read_head(ring);
+	br_store_head(&(ring->read), ring->read + 1);
+	br_check_truths(ring);
+}
+
+inline static void br_move_write_line_forward(byte_ring_t* ring)
+{
+	// the size of the written data is already in the size map
+	// it is published to the consumer along with the write head
+	br_trace(ring, BR_TRACE_LINE_ADVANCE, ring->write, br_get_size(ring, ring->write));
+	br_stats_count_published(ring, br_get_size(ring, ring->write));
+	size_t next = br_get_slot(ring, ring->write + 1);
+	if(true == br_is_packed(ring)) { br_get_offset_map(ring)[next] = br_get_next_offset(ring); }
+	br_set_size(ring, next, 0);
+
+	// a batched line is published later on by br_publish, but the write head is read by br_check_truths
+	if(true == br_is_batched(ring))
+	{
+		__atomic_store_n(&(ring->write), ring->write + 1, __ATOMIC_RELAXED);
+		br_count_batched_line(ring);
+	}
+	else
+	{
+		br_store_head(&(ring->write), ring->write + 1);
+		br_notify_consumer(ring);
+	}
+
+	br_check_truths(ring);
+}
+
+inline static void br_increment_write(byte_ring_t* ring, bool force)
+{
+	bool clobber = br_read_will_point_to_write(ring);
+	if(true == clobber && false == force) { goto function_exit; }
+	if(true == clobber) { br_move_read_line_forward(ring); }
+	br_move_write_line_forward(ring);
+function_exit:
+	br_check_truths(ring);
+}
+
+inline static void br_increment_read(byte_ring_t* ring, bool force)
+{
+	bool clobber = br_read_will_point_to_write(ring);
+	if(true == clobber && false == force) { goto function_exit; }
+	if(true == clobber) { br_move_write_line_forward(ring); }
+	br_move_read_line_forward(ring);
+function_exit:
+	br_check_truths(ring);
+}
+
+// the br_prepare_* functions apply a behavior to the write line before data is written
+// they return true when the write line has room for at least one more byte
+
+// return true == room was made, always returns true
+static bool br_prepare_overwrite_oldest(byte_ring_t* ring)
+{
+	bool clobber		= br_write_will_point_to_read(ring);
+	bool full				=	br_write_line_is_full(ring);
+	bool overwrite	= clobber && full;
+
+	// a line always frees room for another one, unless lines are packed and the oldest was shorter than the next
+	while(true == overwrite)
+	{
+		br_trace(ring, BR_TRACE_OVERWRITE, ring->read, br_get_size(ring, ring->read));
+		br_move_read_line_forward(ring);
+		_br_add_producer_flags(ring, BR_FLAG_OVERWRITE);
+		br_stats_count_overwrite(ring, BR_OVERWRITE_OLDEST);
+		overwrite = br_write_will_point_to_read(ring);
+	}
+
+	if(true == full)
+	{
+		br_move_write_line_forward(ring);
+	}
+
+	return (true);
+}
+
+// return true == room was made, always returns true
+static bool br_prepare_overwrite_newest(byte_ring_t* ring)
+{
+	bool clobber		= br_write_will_point_to_read(ring);
+	bool full				=	br_write_line_is_full(ring);
+	bool overwrite	= clobber && full;
+
+	if(true == overwrite)
+	{
+		br_trace(ring, BR_TRACE_OVERWRITE, ring->write, br_get_size(ring, ring->write));
+		br_reset_write_head(ring);
+		_br_add_producer_flags(ring, BR_FLAG_OVERWRITE);
+		br_stats_count_overwrite(ring, BR_OVERWRITE_NEWEST);
+	}
+
+	if((false == overwrite) && (true == full))
+	{
+		br_move_write_line_forward(ring);
+	}
+
+	return (true);
+}
+
+// returns true == room was made, when ring was not full
+// returns false == no mutation, when ring was full
+static bool br_prepare_refuse_overwrite(byte_ring_t* ring)
+{
+	bool clobber				= br_write_will_point_to_read(ring);
+	bool full						=	br_write_line_is_full(ring);
+	bool overwrite			= clobber && full;
+
+	if((false == overwrite) && (true == full))
+	{
+		br_move_write_line_forward(ring);
+	}
+
+	if(true == overwrite)
+	{
+		br_trace(ring, BR_TRACE_REFUSAL, ring->write, br_get_size(ring, ring->write));
+		br_stats_count_refusal(ring);
+	}
+
+	return (false == overwrite);
+}
+
+// the behavior a write takes, 0 with several producers, whose lines are only written through br_claim_line
+inline static uint32_t br_get_push_behavior(byte_ring_t* ring)
+{
+	uint32_t flags = _br_get_immutable_flags(ring);
+	return ((0 != (flags & BR_CONCURRENT_MPSC)) ? 0 : (flags & BR_OVERWRITE_FLAGS_MASK));
+}
+
+// behavior is a constant wherever this is inlined into one of the entry points for a single behavior, like br_push_oldest
+// so the switch folds away there, and only br_prepare_write and the others for any behavior keep it
+inline static bool br_prepare_write_as(byte_ring_t* ring, uint32_t behavior)
+{
+	bool function_value = false;
+
+	switch(behavior)
+	{
+		case BR_OVERWRITE_OLDEST:
+			function_value = br_prepare_overwrite_oldest(ring);
+			break;
+
+		case BR_OVERWRITE_NEWEST:
+			function_value = br_prepare_overwrite_newest(ring);
+			break;
+
+		case BR_OVERWRITE_REFUSAL:
+			function_value = br_prepare_refuse_overwrite(ring);
+			break;
+
+		default:
+			break;
+	}
+
+	return (function_value);
+}
+
+inline static bool br_prepare_write(byte_ring_t* ring)
+{
+	return (br_prepare_write_as(ring, br_get_push_behavior(ring)));
+}
+
+// return true == push_success, always returns true
+static bool br_push_overwrite_oldest(byte_ring_t* ring, uint8_t byte)
+{
+	br_prepare_overwrite_oldest(ring);
+	br_write_byte(ring, byte);
+	br_check_truths(ring);
+	return (true);
+}
+
+// return true == push_success, always returns true
+static bool br_push_overwrite_newest(byte_ring_t* ring, uint8_t byte)
+{
+	br_prepare_overwrite_newest(ring);
+	br_write_byte(ring, byte);
+	br_check_truths(ring);
+	return (true);
+}
+
+// returns true == push_success, when ring was not full
+// returns false == no mutation, when ring was full
+static bool br_push_refuse_overwrite(byte_ring_t* ring, uint8_t byte)
+{
+	bool function_value = br_prepare_refuse_overwrite(ring);
+
+	if(true == function_value)
+	{
+		br_write_byte(ring, byte);
+	}
+
+	br_check_truths(ring);
+	return (function_value);
+}
+
+// nobody waits on a new ring, the notification fd is only opened when asked for, and no selector holds it
+inline static void br_init_notify(byte_ring_t* ring)
+{
+	ring->spin_budget					= BR_WAIT_SPINS_MIN;
+	ring->waiting							= 0;
+	ring->wake_sequence				= 0;
+	ring->notify_fd						= -1;
+	ring->notify_pid					= 0;
+	ring->selector						= NULL;
+	ring->selector_slot				= 0;
+}
+
+inline static void br_init_batch(byte_ring_t* ring)
+{
+	ring->batch_limit					= BR_PUBLISH_BATCH_LINES;
+	ring->batch_delay_ns			= 0;
+	ring->batch_started				= 0;
+}
+
+// the counters start over with every ring, and with every process that opens a ring file
+inline static void br_init_stats(byte_ring_t* ring)
+{
+#	ifdef BR_STATS
+	memset(&(ring->producer_stats), 0, sizeof(ring->producer_stats));
+	memset(&(ring->consumer_stats), 0, sizeof(ring->consumer_stats));
+#	endif
+	(void) ring;
+}
+
+// empties the ring without touching the backing store
+// only the lines the empty ring starts on are reset, every other line has its size reset before it is written
+// with several producers the consumer only checks a line is committed, so the lines it never reached are reset too
+// every line behind the read head was already reset when the read head passed it
+static void br_reset_cursors(byte_ring_t* ring)
+{
+	if(true == br_is_multi_producer(ring))
+	{
+		for(uint64_t line = ring->read; line != ring->write; ++line)
+		{
+			br_set_size(ring, br_get_slot(ring, line), 0);
+		}
+	}
+
+	// the read head starts on the final line and the write head on the first one
+	ring->read					= ring->number_lines - 1;
+	ring->write					= ring->number_lines;
+	ring->cached_read		= ring->read;
+	ring->cached_write	= ring->write;
+	ring->published			= ring->write;
+	ring->batch_lines		= 0;
+
+	if(true == br_is_packed(ring))
+	{
+		br_get_offset_map(ring)[br_get_slot(ring, ring->read)]		= 0;
+		br_get_offset_map(ring)[br_get_slot(ring, ring->write)]	= 0;
+	}
+
+	br_reset_read_head(ring);
+	br_reset_write_head(ring);
+	ring->bytes_written	= 0;
+	ring->bytes_released	= 0;
+
+	_br_clear_event_flags(ring);
+	br_check_truths(ring);
+}
+
+// zeroes the size and offset maps and empties the ring, the backing store is left as it is
+static void br_wipe_maps(byte_ring_t* ring)
+{
+	memset(br_get_size_map(ring), 0, ring->size_width * (ring->number_lines));
+	if(true == br_is_packed(ring)) { memset(br_get_offset_map(ring), 0, sizeof(uint64_t) * (ring->number_lines)); }
+
+	br_reset_cursors(ring);
+}
+
+// zeroes everything and empties the ring, the create functions start every ring from here
+static void br_wipe(byte_ring_t* ring)
+{
+	size_t size = br_get_backing_store_size(ring);
+	uint8_t* backing_store = br_get_first_line(ring);
+	memset(backing_store, 0, size * sizeof(uint8_t));
+	br_wipe_maps(ring);
+}
+
+// a store the ring just mapped comes zeroed from the kernel, and is not touched, so its pages are only faulted in
+// during the first pass through the ring, or by br_prefault when asked for
+static void br_wipe_created(byte_ring_t* ring)
+{
+	if(0 != (_br_get_immutable_flags(ring) & BR_BACKING_STORE_MAPPED))
+	{
+		br_wipe_maps(ring);
+	}
+	else
+	{
+		br_wipe(ring);
+	}
+}
+
+#ifdef __linux__
+// maps size bytes of memory twice, back to back, so whatever runs past the end of the first mapping lands at its start
+// size has to be a whole number of pages
+static uint8_t* br_map_mirrored(size_t size)
+{
+	uint8_t* function_value = NULL;
+	int fd = (int) syscall(SYS_memfd_create, "byte_ring", MFD_CLOEXEC);
+	if(-1 == fd) { goto fail_early; }
+	if(0 != ftruncate(fd, (off_t) size)) { goto function_exit; }
+
+	// reserve room for both mappings first, so nothing else can be mapped in between them
+	uint8_t* base = (uint8_t*) mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(MAP_FAILED == base) { goto function_exit; }
+
+	if((MAP_FAILED == mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0))
+		|| (MAP_FAILED == mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)))
+	{
+		munmap(base, 2 * size);
+		goto function_exit;
+	}
+
+	function_value = base;
+function_exit:
+	// the mappings keep the memory alive on their own
+	close(fd);
+fail_early:
+	return (function_value);
+}
+#endif
+
+inline static size_t br_get_page_size(void)
+{
+	return ((size_t) sysconf(_SC_PAGESIZE));
+}
+
+inline static size_t br_round_up(size_t size, size_t multiple)
+{
+	return ((size + multiple - 1) / multiple * multiple);
+}
+
+// used by the create functions that are not given any options
+static const br_alloc_options_t br_default_alloc_options;
+
+// the heap cannot be bound to a node or asked for huge pages, the store is mapped instead
+inline static bool br_store_needs_mapping(const br_alloc_options_t* options)
+{
+	return ((BR_PAGES_DEFAULT != options->pages) || (true == options->numa_bind));
+}
+
+#ifdef __linux__
+// mapped in whole huge pages for either kind, so transparent huge pages can back all of it
+static uint8_t* br_map_anonymous(size_t size, const br_alloc_options_t* options, size_t* mapped_size)
+{
+	uint8_t* function_value = NULL;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	size_t page = br_get_page_size();
+
+	if(BR_PAGES_DEFAULT != options->pages) { page = BR_HUGE_PAGE_SIZE; }
+	if(BR_PAGES_HUGETLB == options->pages) { flags |= MAP_HUGETLB; }
+
+	*mapped_size = br_round_up(size, page);
+	function_value = (uint8_t*) mmap(NULL, *mapped_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	if(MAP_FAILED == function_value) { function_value = NULL; }
+
+	return (function_value);
+}
+
+// has to run before anything touches the mapping, pages already faulted in stay where they are
+static bool br_place_mapping(uint8_t* store, size_t mapped_size, const br_alloc_options_t* options)
+{
+	bool function_value = true;
+
+	if(BR_PAGES_TRANSPARENT_HUGE == options->pages)
+	{
+		// only a hint, the store still works without huge pages
+		madvise(store, mapped_size, MADV_HUGEPAGE);
+	}
+
+	if(true == options->numa_bind)
+	{
+		unsigned long mask[BR_MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0 };
+		mask[options->numa_node / (8 * sizeof(unsigned long))] = 1UL << (options->numa_node % (8 * sizeof(unsigned long)));
+
+		// through syscall, so there is no need to link libnuma
+		function_value = (0 == syscall(SYS_mbind, store, mapped_size, MPOL_BIND, mask, BR_MAX_NUMA_NODES + 1, 0));
+	}
+
+	return (function_value);
+}
+#endif
+
+// touches a page at a time, so the first pass through the ring does not stall on page faults
+// only for mapped stores, a store from the heap is zeroed by br_wipe during creation, which faults it in anyway
+static void br_prefault(uint8_t* store, size_t size)
+{
+	size_t page = br_get_page_size();
+	for(size_t i = 0; i < size; i += page)
+	{
+		((volatile uint8_t*) store)[i] = 0;
+	}
+}
+
+// allocates a size byte backing store wrt BR_MIRRORED_STORE and the options
+// alloc_flag is set to the alloc flag the backing store has to be released with, and mapped_size to how much was mapped
+static uint8_t* br_alloc_backing_store(size_t size, uint32_t behavior_flag, const br_alloc_options_t* options,
+		uint32_t* alloc_flag, size_t* mapped_size)
+{
+	uint8_t* function_value = NULL;
+	bool mirrored = (0 != (behavior_flag & BR_MIRRORED_STORE));
+	*alloc_flag = BR_BACKING_STORE_ALLOC;
+	*mapped_size = 0;
+
+	if(BR_MAX_NUMA_NODES <= options->numa_node) { goto fail_early; }
+
+	if((false == mirrored) && (false == br_store_needs_mapping(options)))
+	{
+		// aligned_alloc wants the size to be a multiple of the alignment
+		if(0 == options->alignment) { function_value = (uint8_t*) malloc(size); }
+		if(0 != options->alignment) { function_value = (uint8_t*) aligned_alloc(options->alignment, br_round_up(size, options->alignment)); }
+		goto function_exit;
+	}
+
+#	ifdef __linux__
+	*alloc_flag = BR_BACKING_STORE_MAPPED;
+
+	// a mapping is aligned to its pages and no further, and the mirror cannot be made out of huge pages
+	size_t page = br_get_page_size();
+	if(BR_PAGES_DEFAULT != options->pages) { page = BR_HUGE_PAGE_SIZE; }
+	if(page < options->alignment) { goto fail_early; }
+
+	if(true == mirrored)
+	{
+		if(BR_PAGES_HUGETLB == options->pages) { goto fail_early; }
+		if((0 == size) || (0 != (size % br_get_page_size()))) { goto fail_early; }
+		function_value = br_map_mirrored(size);
+		*mapped_size = 2 * size;
+	}
+
+	if(false == mirrored)
+	{
+		function_value = br_map_anonymous(size, options, mapped_size);
+	}
+
+	if((NULL != function_value) && (false == br_place_mapping(function_value, *mapped_size, options)))
+	{
+		munmap(function_value, *mapped_size);
+		function_value = NULL;
+	}
+
+	// both views of a mirrored store, so neither faults during the first pass
+	if((NULL != function_value) && (true == options->prefault)) { br_prefault(function_value, *mapped_size); }
+#	endif
+
+function_exit:
+fail_early:
+	return (function_value);
+}
+
+static void br_free_backing_store(uint8_t* backing_store, size_t mapped_size, uint32_t alloc_flag)
+{
+	if(NULL == backing_store) { goto function_exit; }
+
+	if(BR_BACKING_STORE_ALLOC & alloc_flag)
+	{
+		free(backing_store);
+	}
+
+#	ifdef __linux__
+	if(BR_BACKING_STORE_MAPPED & alloc_flag)
+	{
+		munmap(backing_store, mapped_size);
+	}
+#	endif
+
+function_exit:
+	(void) mapped_size;
+}
+
+byte_ring_t* br_create_full_alloc(size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag)
+{
+	return (br_create_full_alloc_with(n_lines, len_lines, behavior_flag, &br_default_alloc_options));
+}
+
+byte_ring_t* br_create_full_alloc_with(size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag, const br_alloc_options_t* options)
+{
+	size_t size								= len_lines * n_lines;
+	size_t mapped_size				= 0;
+	uint32_t store_alloc			= 0;
+	byte_ring_t* ring					= NULL;
+	if(false == br_behavior_is_supported(behavior_flag)) { goto fail_early; }
+
+	ring											= (byte_ring_t*) aligned_alloc(BR_CACHE_LINE_SIZE, sizeof(byte_ring_t));
+	if(NULL == ring) { goto fail_early; }
+
+	uint8_t* backing_store		= br_alloc_backing_store(size, behavior_flag, options, &store_alloc, &mapped_size);
+	if(NULL == backing_store)
+	{
+		free(ring);
+		ring = NULL;
+		goto fail_early;
+	}
+
+	void* size_map						= malloc(br_get_size_map_size(n_lines, len_lines));
+	if(NULL == size_map)
+	{
+		free(ring);
+		br_free_backing_store(backing_store, mapped_size, store_alloc);
+		ring = NULL;
+		goto fail_early;
+	}
+
+	ring->size_map_offset			= br_get_distance(ring, size_map);
+	ring->offset_map_offset			= 0;
+	br_init_notify(ring);
+	br_init_batch(ring);
+	br_init_stats(ring);
+	ring->backing_store_offset		= br_get_distance(ring, backing_store);
+	ring->backing_store_mapped_size	= mapped_size;
+	
+	_br_set_flags(ring, 0);
+	_br_add_flags(ring, store_alloc | BR_STRUCT_ALLOC | BR_SIZEMAP_ALLOC | behavior_flag);
+	br_set_geometry(ring, n_lines, len_lines);
+
+	br_wipe_created(ring);
+fail_early:
+	return ring;
+}
+
+byte_ring_t* br_create_alloc_static_backing_store(size_t n_lines,
+		size_t len_lines, BR_BEHAVIOR_FLAGS behavior_flag,
+		uint8_t* backing_store)
+{
+	byte_ring_t* ring					= NULL;
+	if(false == br_behavior_is_supported(behavior_flag)) { goto fail_early; }
+
+	// only a backing store the ring maps itself can be mirrored
+	if(0 != (behavior_flag & BR_MIRRORED_STORE)) { goto fail_early; }
+
+	ring											= (byte_ring_t*) aligned_alloc(BR_CACHE_LINE_SIZE, sizeof(byte_ring_t));
+	if(NULL == ring) { goto fail_early; }
+
+	void* size_map						= malloc(br_get_size_map_size(n_lines, len_lines));
+	if(NULL == size_map)
+	{
+		free(ring);
+		ring = NULL;
+		goto fail_early;
+	}
+
+	ring->size_map_offset			= br_get_distance(ring, size_map);
+	ring->offset_map_offset			= 0;
+	br_init_notify(ring);
+	br_init_batch(ring);
+	br_init_stats(ring);
+	ring->backing_store_offset		= br_get_distance(ring, backing_store);
+	ring->backing_store_mapped_size	= 0;
+	
+	_br_set_flags(ring, 0);
+	_br_add_flags(ring, BR_STRUCT_ALLOC | BR_SIZEMAP_ALLOC | behavior_flag);
+	br_set_geometry(ring, n_lines, len_lines);
+
+	br_wipe(ring);
+fail_early:
+	return ring;
+}
+
+int br_alloc_full_static(byte_ring_t* ring, size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag, uint8_t* backing_store)
+{
+	int function_value				=	-1;
+	if(false == br_behavior_is_supported(behavior_flag)) { goto function_exit; }
+	if(0 != (behavior_flag & BR_MIRRORED_STORE)) { goto function_exit; }
+
+	ring->backing_store_offset		= br_get_distance(ring, backing_store);
+	ring->backing_store_mapped_size	= 0;
+	ring->offset_map_offset			= 0;
+	br_init_notify(ring);
+	br_init_batch(ring);
+	br_init_stats(ring);
+	
+	_br_set_flags(ring, 0);
+	_br_add_flags(ring, BR_SIZEMAP_ALLOC | behavior_flag);
+	br_set_geometry(ring, n_lines, len_lines);
+
+	void* size_map						= malloc(br_get_size_map_size(n_lines, len_lines));
+	if(NULL == size_map)
+	{
+		goto function_exit;
+	}
+
+	ring->size_map_offset			= br_get_distance(ring, size_map);
+	br_wipe(ring);
+	function_value = 0;
+function_exit:
+	return function_value;
+}
+
+byte_ring_t* br_create_packed_alloc(size_t n_lines, size_t len_lines,
+		size_t store_size, BR_BEHAVIOR_FLAGS behavior_flag)
+{
+	return (br_create_packed_alloc_with(n_lines, len_lines, store_size, behavior_flag, &br_default_alloc_options));
+}
+
+byte_ring_t* br_create_packed_alloc_with(size_t n_lines, size_t len_lines,
+		size_t store_size, BR_BEHAVIOR_FLAGS behavior_flag, const br_alloc_options_t* options)
+{
+	size_t mapped_size				= 0;
+	uint32_t store_alloc			= 0;
+	byte_ring_t* ring					= NULL;
+	if(false == br_behavior_is_supported(behavior_flag)) { goto fail_early; }
+
+	// claimed lines are filled out of order, so a line cannot start where the one before it ended
+	if(0 != (behavior_flag & BR_CONCURRENT_MPSC)) { goto fail_early; }
+	if(store_size < BR_PACKED_MIN_LINES * len_lines) { goto fail_early; }
+
+	// a mirrored store is mapped in whole pages, the extra room is used rather than wasted
+	size_t page = br_get_page_size();
+	if(0 != (behavior_flag & BR_MIRRORED_STORE)) { store_size = (store_size + page - 1) / page * page; }
+
+	ring											= (byte_ring_t*) aligned_alloc(BR_CACHE_LINE_SIZE, sizeof(byte_ring_t));
+	if(NULL == ring) { goto fail_early; }
+
+	uint8_t* backing_store		= br_alloc_backing_store(store_size, behavior_flag, options, &store_alloc, &mapped_size);
+	void* size_map						= malloc(br_get_size_map_size(n_lines, len_lines));
+	uint64_t* offset_map			= (uint64_t*) malloc(sizeof(uint64_t) * n_lines);
+	if((NULL == backing_store) || (NULL == size_map) || (NULL == offset_map))
+	{
+		free(ring);
+		br_free_backing_store(backing_store, mapped_size, store_alloc);
+		free(size_map);
+		free(offset_map);
 		ring = NULL;
 		goto fail_early;
 	}
 
-	ring->size_map						=	size_map;
-	ring->backing_store				= backing_store;
-	ring->backing_store_size	= size;
-	ring->number_lines				= n_lines;
-	ring->line_length					= len_lines;
+	ring->size_map_offset			= br_get_distance(ring, size_map);
+	ring->offset_map_offset			= br_get_distance(ring, offset_map);
+	br_init_notify(ring);
+	br_init_batch(ring);
+	br_init_stats(ring);
+	ring->backing_store_offset		= br_get_distance(ring, backing_store);
+	ring->backing_store_mapped_size	= mapped_size;
+
+	_br_set_flags(ring, 0);
+	_br_add_flags(ring, store_alloc | BR_STRUCT_ALLOC | BR_SIZEMAP_ALLOC | BR_OFFSETMAP_ALLOC
+		| BR_PACKED_RECORDS | behavior_flag);
+	br_set_geometry(ring, n_lines, len_lines);
+	ring->backing_store_size	= store_size;
+
+	br_wipe_created(ring);
+fail_early:
+	return ring;
+}
+
+// one block holds the struct, then the size map, then the backing store, each starting on its own cache line
+inline static size_t br_get_size_map_offset(void)
+{
+	return (br_round_up(sizeof(byte_ring_t), BR_CACHE_LINE_SIZE));
+}
+
+inline static size_t br_get_store_offset(size_t n_lines, size_t len_lines)
+{
+	return (br_get_size_map_offset() + br_round_up(br_get_size_map_size(n_lines, len_lines), BR_CACHE_LINE_SIZE));
+}
+
+size_t br_required_size(size_t n_lines, size_t len_lines)
+{
+	return (br_get_store_offset(n_lines, len_lines) + br_round_up(n_lines * len_lines, BR_CACHE_LINE_SIZE));
+}
+
+byte_ring_t* br_create_in_place(void* buffer, size_t buffer_size, size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag)
+{
+	byte_ring_t* ring					= NULL;
+	if(false == br_behavior_is_supported(behavior_flag)) { goto fail_early; }
+	if(0 != (behavior_flag & BR_MIRRORED_STORE)) { goto fail_early; }
+
+	// the struct keeps its two sides on separate cache lines, so it has to start on one
+	if(0 != ((uintptr_t) buffer % BR_CACHE_LINE_SIZE)) { goto fail_early; }
+	if(buffer_size < br_required_size(n_lines, len_lines)) { goto fail_early; }
+
+	ring											= (byte_ring_t*) buffer;
+	ring->size_map_offset			= br_get_distance(ring, (uint8_t*) buffer + br_get_size_map_offset());
+	ring->offset_map_offset			= 0;
+	br_init_notify(ring);
+	br_init_batch(ring);
+	br_init_stats(ring);
+	ring->backing_store_offset		= br_get_distance(ring, (uint8_t*) buffer + br_get_store_offset(n_lines, len_lines));
+	ring->backing_store_mapped_size	= 0;
+
+	// nothing in the block was allocated by the ring
+	_br_set_flags(ring, 0);
+	_br_add_flags(ring, behavior_flag);
+	br_set_geometry(ring, n_lines, len_lines);
+
+	br_wipe(ring);
+fail_early:
+	return ring;
+}
+
+// the heads and sizes are only trusted after they are checked,
+//		a file the kernel never wrote back whole or memory another process handed over can hold anything
+// the geometry is passed in, it has already been checked, and the struct may not hold it yet
+static bool br_state_is_valid(byte_ring_t* ring, const void* size_map, size_t n_lines, size_t len_lines)
+{
+	size_t size_width = br_get_size_width(len_lines);
+	size_t line_committed = ((size_t) 1) << (size_width * 8 - 1);
+	bool function_value = (ring->read < ring->write) && (ring->write - ring->read <= n_lines - 1);
+
+	for(size_t slot = 0; (true == function_value) && (slot < n_lines); slot++)
+	{
+		function_value = ((br_get_size_entry_at(size_map, size_width, slot) & ~line_committed) <= len_lines);
+	}
+
+	return (function_value);
+}
+
+// the ring is already in the block, only what br_create_in_place would have written is checked
+byte_ring_t* br_attach(void* buffer, size_t buffer_size)
+{
+	byte_ring_t* ring					= (byte_ring_t*) buffer;
+	bool valid								= false;
+
+	if((NULL == buffer) || (0 != ((uintptr_t) buffer % BR_CACHE_LINE_SIZE))) { goto fail_early; }
+	if(buffer_size < sizeof(byte_ring_t)) { goto fail_early; }
+
+	// a ring that owns allocations lives in one process only
+	uint32_t flags						= _br_get_immutable_flags(ring);
+	if(0 != (flags & BR_ALLOC_FLAGS_MASK)) { goto fail_early; }
+	if(false == br_behavior_is_supported(flags & BR_BEHAVIOR_FLAGS_MASK)) { goto fail_early; }
+
+	size_t n_lines						= ring->number_lines;
+	size_t len_lines					= ring->line_length;
+	// bounds both before they are multiplied, whatever is in the block
+	if((2 > n_lines) || (0 == len_lines) || (n_lines > buffer_size) || (len_lines > buffer_size)) { goto fail_early; }
+	if(buffer_size < br_required_size(n_lines, len_lines)) { goto fail_early; }
+
+	valid											= (br_get_distance(ring, (uint8_t*) buffer + br_get_size_map_offset()) == ring->size_map_offset)
+		&& (0 == ring->offset_map_offset)
+		&& (br_get_distance(ring, (uint8_t*) buffer + br_get_store_offset(n_lines, len_lines)) == ring->backing_store_offset)
+		&& (br_get_size_width(len_lines) == ring->size_width)
+		&& ((((size_t) 1) << (ring->size_width * 8 - 1)) == ring->line_committed)
+		&& ((n_lines * len_lines) == ring->backing_store_size)
+		&& (br_get_line_mask(n_lines) == ring->line_mask)
+		&& (true == br_state_is_valid(ring, br_get_size_map(ring), n_lines, len_lines));
+
+fail_early:
+	return ((true == valid) ? ring : NULL);
+}
+
+byte_ring_t* br_create_single_alloc(size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag)
+{
+	size_t size								= br_required_size(n_lines, len_lines);
+	byte_ring_t* ring					= NULL;
+
+	void* block								= aligned_alloc(BR_CACHE_LINE_SIZE, size);
+	if(NULL == block) { goto fail_early; }
+
+	ring											= br_create_in_place(block, size, n_lines, len_lines, behavior_flag);
+	if(NULL == ring)
+	{
+		free(block);
+		goto fail_early;
+	}
+
+	// the struct is at the start of the block, so freeing the struct frees all of it
+	_br_add_flags(ring, BR_STRUCT_ALLOC);
+fail_early:
+	return ring;
+}
+
+#ifdef __linux__
+// a ring file is this header followed by the block br_create_in_place builds
+// the struct is kept in the file as it is, so the version also covers its size and the cache line it was built with
+static void br_create_mapped_header(br_file_header_t* header, size_t file_size, size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag)
+{
+	memcpy(header->magic, BR_FILE_MAGIC, sizeof(header->magic));
+	header->version					= BR_FILE_VERSION;
+	header->struct_size			= (uint32_t) sizeof(byte_ring_t);
+	header->cache_line_size	= BR_CACHE_LINE_SIZE;
+	header->file_size				= file_size;
+	header->number_lines		= n_lines;
+	header->line_length			= len_lines;
+	header->behavior_flags	= behavior_flag;
+	header->clean						= 0;
+}
+
+inline static bool br_file_header_is_valid(const br_file_header_t* header, size_t file_size)
+{
+	bool function_value = (file_size >= br_get_file_header_size());
+	if(false == function_value) { goto function_exit; }
+
+	function_value = (0 == memcmp(header->magic, BR_FILE_MAGIC, sizeof(header->magic)))
+		&& (BR_FILE_VERSION == header->version)
+		&& (sizeof(byte_ring_t) == header->struct_size)
+		&& (BR_CACHE_LINE_SIZE == header->cache_line_size)
+		&& (file_size == header->file_size)
+		// bounds both before they are multiplied, the same as br_attach
+		&& (2 <= header->number_lines) && (0 != header->line_length)
+		&& (header->number_lines <= file_size) && (header->line_length <= file_size)
+		&& (file_size - br_get_file_header_size() >= br_required_size(header->number_lines, header->line_length))
+		&& (0 == (header->behavior_flags & ~BR_BEHAVIOR_FLAGS_MASK))
+		&& (true == br_behavior_is_supported(header->behavior_flags));
+
+function_exit:
+	return (function_value);
+}
+
+// what the last owner of the file left behind, when it did not get to br_destroy
+// the write line may hold part of a record, and with several producers a claimed line may never have been committed
+static void br_recover_mapped(byte_ring_t* ring)
+{
+	bool torn = (0 != br_get_size(ring, ring->write));
+
+	for(uint64_t line = ring->read + 1; (true == br_is_multi_producer(ring)) && (line != ring->write); ++line)
+	{
+		size_t slot = br_get_slot(ring, line);
+		if(0 != (br_get_size_entry(ring, slot) & ring->line_committed)) { continue; }
+
+		// an empty line takes the place of the lost one, so the lines behind it still reach the consumer
+		br_set_size(ring, slot, ring->line_committed);
+		torn = true;
+	}
+
+	if(true == torn) { _br_add_flags(ring, BR_FLAG_TORN_LINE); }
+}
+
+// the byte counters only have to add up to the size map, and a file that was not closed may have lost either one
+static void br_recount_bytes(byte_ring_t* ring)
+{
+	ring->bytes_written		= 0;
+	ring->bytes_released	= 0;
+
+	for(uint64_t line = ring->read; line != ring->write + 1; ++line)
+	{
+		ring->bytes_written += br_get_size(ring, line);
+	}
+}
+
+byte_ring_t* br_create_mapped(const char* path, size_t n_lines, size_t len_lines, BR_BEHAVIOR_FLAGS behavior_flag)
+{
+	byte_ring_t* ring					= NULL;
+	size_t file_size					= br_get_file_header_size() + br_required_size(n_lines, len_lines);
+
+	int fd										= open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(-1 == fd) { goto fail_early; }
+	if(0 != ftruncate(fd, (off_t) file_size)) { goto fail_file; }
+
+	uint8_t* map							= mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(MAP_FAILED == map) { goto fail_file; }
+
+	br_create_mapped_header((br_file_header_t*) map, file_size, n_lines, len_lines, behavior_flag);
+	ring											= br_create_in_place(map + br_get_file_header_size(), file_size - br_get_file_header_size(),
+		n_lines, len_lines, behavior_flag);
+
+	if(NULL == ring)
+	{
+		munmap(map, file_size);
+		goto fail_file;
+	}
+
+	_br_add_flags(ring, BR_FILE_MAPPED);
+
+fail_file:
+	close(fd);
+fail_early:
+	return ring;
+}
+
+byte_ring_t* br_open_mapped(const char* path)
+{
+	byte_ring_t* ring					= NULL;
+	struct stat status;
+
+	int fd										= open(path, O_RDWR | O_CLOEXEC);
+	if(-1 == fd) { goto fail_early; }
+	if((0 != fstat(fd, &status)) || (status.st_size < (off_t) br_get_file_header_size())) { goto fail_file; }
+
+	size_t file_size					= (size_t) status.st_size;
+	uint8_t* map							= mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(MAP_FAILED == map) { goto fail_file; }
+
+	br_file_header_t* header	= (br_file_header_t*) map;
+	ring											= (byte_ring_t*) (map + br_get_file_header_size());
+	if(false == br_file_header_is_valid(header, file_size)) { goto fail_map; }
+
+	// a file that is turned down is left as it was, so the heads and sizes are checked before anything is written
+	if(false == br_state_is_valid(ring, (uint8_t*) ring + br_get_size_map_offset(), header->number_lines, header->line_length))
+	{
+		goto fail_map;
+	}
+
+	// the offsets are worked out again, and the geometry and flags are taken from the header again
+	// the heads, sizes, lines and event flags are where they were left
+	ring->size_map_offset			= br_get_distance(ring, (uint8_t*) ring + br_get_size_map_offset());
+	ring->backing_store_offset		= br_get_distance(ring, (uint8_t*) ring + br_get_store_offset(header->number_lines, header->line_length));
+	ring->offset_map_offset			= 0;
+	_br_set_flags(ring, (_br_load_flags(&(ring->bit_flags)) & BR_EVENT_FLAGS_MASK) | header->behavior_flags | BR_FILE_MAPPED);
+	br_set_geometry(ring, header->number_lines, header->line_length);
+
+	br_init_notify(ring);
+	br_init_batch(ring);
+	br_init_stats(ring);
+
+	// lines the last owner held back in a batch are published now
+	ring->published						= ring->write;
+	ring->batch_lines					= 0;
+
+	if(0 == __atomic_load_n(&(header->clean), __ATOMIC_ACQUIRE)) { br_recover_mapped(ring); }
+	br_recount_bytes(ring);
+	__atomic_store_n(&(header->clean), 0, __ATOMIC_RELEASE);
+	goto fail_file;
+
+fail_map:
+	munmap(map, file_size);
+	ring = NULL;
+fail_file:
+	close(fd);
+fail_early:
+	return ring;
+}
+
+bool br_sync_mapped(byte_ring_t* ring)
+{
+	bool function_value = false;
+	if(0 == (_br_get_immutable_flags(ring) & BR_FILE_MAPPED)) { goto function_exit; }
+
+	br_file_header_t* header = br_get_file_header(ring);
+	function_value = (0 == msync(header, (size_t) header->file_size, MS_SYNC));
+
+function_exit:
+	return (function_value);
+}
+#endif
+
+void br_destroy_internals(byte_ring_t* ring)
+{
+	uint32_t alloc_map = _br_get_immutable_flags(ring) & BR_ALLOC_FLAGS_MASK;
+	uint8_t* backing_store = br_get_first_line(ring);
+
+	if((BR_BACKING_STORE_ALLOC | BR_BACKING_STORE_MAPPED) & alloc_map)
+	{
+		br_free_backing_store(backing_store, ring->backing_store_mapped_size, alloc_map);
+		ring->backing_store_offset = 0;
+	}
+
+	if(BR_SIZEMAP_ALLOC & alloc_map)
+	{
+		free(br_get_size_map(ring));
+		ring->size_map_offset = 0;
+	}
+
+	if(BR_OFFSETMAP_ALLOC & alloc_map)
+	{
+		free(br_get_offset_map(ring));
+		ring->offset_map_offset = 0;
+	}
+
+	if((-1 != ring->notify_fd) && (getpid() == ring->notify_pid))
+	{
+		close(ring->notify_fd);
+		ring->notify_fd = -1;
+	}
+
+#	ifdef __linux__
+	// everything is written back before the file is marked clean, so a clean file never has a torn line
+	if(BR_FILE_MAPPED & alloc_map)
+	{
+		br_file_header_t* header = br_get_file_header(ring);
+		msync(header, (size_t) header->file_size, MS_SYNC);
+		__atomic_store_n(&(header->clean), 1, __ATOMIC_RELEASE);
+		msync(header, br_get_file_header_size(), MS_SYNC);
+	}
+#	endif
+}
+
+void br_destroy(byte_ring_t** ring)
+{
+	uint32_t alloc_map = _br_get_immutable_flags(*ring) & BR_ALLOC_FLAGS_MASK;
+	br_destroy_internals(*ring);
+
+	if(BR_STRUCT_ALLOC & alloc_map) { free(*ring); *ring = NULL; }
+
+#	ifdef __linux__
+	// the struct lives in the mapping, so it goes last
+	if(BR_FILE_MAPPED & alloc_map)
+	{
+		br_file_header_t* header = br_get_file_header(*ring);
+		munmap(header, (size_t) header->file_size);
+		*ring = NULL;
+	}
+#	endif
+}
+
+#ifdef BR_STDIO_DEBUG
+void br_dump_contents(byte_ring_t* ring)
+{
+	uint8_t* line = br_get_first_line(ring);
+
+	while(line <= br_get_final_line(ring))
+	{
+		for(size_t i = 0; i < ring->line_length; i++)
+		{
+			printf("%.2X", line[i]);
+		}
+		puts("");
+
+		if(br_get_final_line(ring) == line)
+		{
+			break;
+		}
+
+		line = br_get_next_line(ring, line);
+	}
+}
+
+void br_print_configuration(byte_ring_t* ring)
+{
+	uint32_t flags = _br_get_immutable_flags(ring);
+	size_t bs_size = br_get_backing_store_size(ring);
+	printf("number lines: %zu\n", ring->number_lines);
+	printf("line length: %zu\n", ring->line_length);
+	printf("backing store size: %zu\n", bs_size);
+	printf("allocation map: 0x%" PRIX32 "\n", flags & BR_ALLOC_FLAGS_MASK);
+	printf("behavior flags: 0x%" PRIX32 "\n", flags & BR_BEHAVIOR_FLAGS_MASK);
+	printf("event flags: 0x%" PRIX32 "\n", _br_get_flags(ring) & BR_EVENT_FLAGS_MASK);
+	
+	printf("overwrite mode: ");
+	switch(flags & BR_OVERWRITE_FLAGS_MASK)
+	{
+		case BR_OVERWRITE_REFUSAL:
+		printf("refused\n");
+		break;
+		case BR_OVERWRITE_NEWEST:
+		printf("newest\n");
+		break;
+		case BR_OVERWRITE_OLDEST:
+		printf("oldest\n");
+		break;
+	}
+
+	printf("read head: %" PRIu64 ", write head: %" PRIu64 "\n", ring->read, ring->write);
+	puts("");
+
+	// only the lines from the read head to the write head hold anything, and packed lines are only found from their heads
+	for(uint64_t head = ring->read; head != ring->write + 1; ++head)
+	{
+		printf("line: %zu @ %p, size: %zu\n", br_get_slot(ring, head), (void*) br_get_line(ring, head), br_get_size(ring, head));
+	}
+}
+#endif
+
+size_t br_peek_read_size(byte_ring_t* ring)
+{
+	return br_get_size(ring, ring->read);
+}
+
+inline const uint8_t* br_peek_read_data(byte_ring_t* ring)
+{
+	const uint8_t* peek = br_get_line(ring, ring->read);
+	return peek;
+}
+
+inline size_t br_peek_write_size(byte_ring_t* ring)
+{
+	return br_get_size(ring, ring->write);
+}
+
+inline const uint8_t* br_peek_write_data(byte_ring_t* ring)
+{
+	const uint8_t* peek = br_get_line(ring, ring->write);
+	return peek;
+}
+
+size_t br_lines_used(byte_ring_t* ring)
+{
+	// the read head is loaded first, it can only have moved closer to the published head by the time that is loaded
+	// the same rule as br_is_empty, the consumer reads up to the published head, or with several producers
+	// nothing past the read line until the line after it is committed
+	uint64_t read = br_load_head(&(ring->read));
+	uint64_t published = br_load_head(br_get_published_head(ring));
+	size_t function_value = 0;
+	if((true == br_is_multi_producer(ring)) && (false == br_line_is_committed(ring, read + 1)))	{ published = read + 1; }
+	if(1 < (int64_t) (published - read))														{ function_value = (size_t) (published - read - 1); }
+	if(0 != br_get_size(ring, read))															{ function_value += 1; }
+
+	return (function_value);
+}
+
+// the write head, not the published one, every line it has moved past takes up room whether the consumer sees it yet or not
+size_t br_lines_free(byte_ring_t* ring)
+{
+	uint64_t read = br_load_head(&(ring->read));
+	uint64_t write = br_load_head(&(ring->write));
+	return ((size_t) (ring->number_lines - 1 - (write - read)));
+}
+
+size_t br_bytes_used(byte_ring_t* ring)
+{
+	// bytes are released after they are written, so loading the released ones first keeps the difference positive
+	uint64_t released = __atomic_load_n(&(ring->bytes_released), __ATOMIC_ACQUIRE);
+	uint64_t written = __atomic_load_n(&(ring->bytes_written), __ATOMIC_ACQUIRE);
+	return ((size_t) (written - released));
+}
+
+bool br_is_empty(byte_ring_t* ring)
+{
+	uint64_t read = br_load_head(&(ring->read));
+	bool function_value = (0 == br_get_size(ring, read));
+
+	// the same rule as br_line_is_last, without touching cached_write
+	if((true == function_value) && (true == br_is_multi_producer(ring)))
+	{
+		function_value = (false == br_line_is_committed(ring, read + 1));
+	}
+	else if(true == function_value)
+	{
+		function_value = ((int64_t) (br_load_head(br_get_published_head(ring)) - read) <= 1);
+	}
+
+	return (function_value);
+}
+
+// the write line's offset and size are the producer's own while it fills the line, so a packed ring is only asked from there
+bool br_is_full(byte_ring_t* ring)
+{
+	uint64_t read = br_load_head(&(ring->read));
+	uint64_t write = br_load_head(&(ring->write));
+	uint64_t next_offset = (true == br_is_packed(ring)) ? br_get_next_offset(ring) : 0;
+	return (br_ring_is_full_after(ring, read, write, next_offset));
+}
+
+bool br_get_stats(byte_ring_t* ring, br_stats_t* out)
+{
+	bool function_value = false;
+	memset(out, 0, sizeof(*out));
+
+#	ifdef BR_STATS
+	const br_producer_stats_t* producer = &(ring->producer_stats);
+	const br_consumer_stats_t* consumer = &(ring->consumer_stats);
+
+	out->bytes_pushed				= __atomic_load_n(&(producer->bytes_pushed), __ATOMIC_RELAXED);
+	out->lines_pushed				= __atomic_load_n(&(producer->lines_pushed), __ATOMIC_RELAXED);
+	out->lines_popped				= __atomic_load_n(&(consumer->lines_popped), __ATOMIC_RELAXED);
+	out->overwrites_oldest	= __atomic_load_n(&(producer->overwrites_oldest), __ATOMIC_RELAXED);
+	out->overwrites_newest	= __atomic_load_n(&(producer->overwrites_newest), __ATOMIC_RELAXED);
+	out->refusals						= __atomic_load_n(&(producer->refusals), __ATOMIC_RELAXED);
+	out->truncations				= __atomic_load_n(&(consumer->truncations), __ATOMIC_RELAXED);
+
+	// each side saw the ring at different moments, the larger of the two is the one that happened
+	out->high_water_lines		= __atomic_load_n(&(producer->high_water_lines), __ATOMIC_RELAXED);
+	uint64_t seen						= __atomic_load_n(&(consumer->high_water_lines), __ATOMIC_RELAXED);
+	if(out->high_water_lines < seen) { out->high_water_lines = seen; }
+
+	for(size_t bucket = 0; bucket < BR_STATS_FILL_BUCKETS; bucket++)
+	{
+		out->fill_histogram[bucket] = __atomic_load_n(&(producer->fill_histogram[bucket]), __ATOMIC_RELAXED);
+	}
+
+	function_value = true;
+#	endif
+
+	(void) ring;
+	return (function_value);
+}
+
+void br_get_backing_store(byte_ring_t* ring, br_span_t* span)
+{
+	// lines of a mirrored packed ring can run on into the second mapping
+	span->data = br_get_first_line(ring);
+	span->size = br_get_backing_store_size(ring);
+	if(true == br_is_mirrored(ring)) { span->size *= 2; }
+}
+
+// === built in predicates ===
+// an empty line is never ready, whichever predicate is asked
+
+inline static int br_check_terminated(const uint8_t* data, size_t size, uint8_t terminator)
+{
+	int function_value = BR_NOT_READY;
+
+	// libc's memchr already scans a vector at a time
+	if((0 != size) && (NULL != memchr(data, terminator, size))) { function_value = BR_READY; }
+	return (function_value);
+}
+
+inline static uint32_t br_load_le32(const uint8_t* data)
+{
+	return ((uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24));
+}
+
+inline static int br_check_length_prefixed(const uint8_t* data, size_t size)
+{
+	int function_value = BR_NOT_READY;
+	if(size < sizeof(uint32_t)) { goto function_exit; }
+
+	// data past the prefixed length cannot belong to the record, the line is malformed
+	uint64_t expected = (uint64_t) br_load_le32(data) + sizeof(uint32_t);
+	if(expected == size) { function_value = BR_READY; }
+	if(expected < size) { function_value = BR_TRUNCATE; }
+
+function_exit:
+	return (function_value);
+}
+
+// crc32c a nibble at a time, the reflected castagnoli polynomial 0x82F63B78
+static const uint32_t br_crc32c_nibbles[16] =
+{
+	0x00000000, 0x105EC76F, 0x20BD8EDE, 0x30E349B1, 0x417B1DBC, 0x5125DAD3, 0x61C69362, 0x7198540D,
+	0x82F63B78, 0x92A8FC17, 0xA24BB5A6, 0xB21572C9, 0xC38D26C4, 0xD3D3E1AB, 0xE330A81A, 0xF36E6F75,
+};
+
+static uint32_t br_crc32c_soft(uint32_t crc, const uint8_t* data, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		crc ^= data[i];
+		crc = (crc >> 4) ^ br_crc32c_nibbles[crc & 0x0F];
+		crc = (crc >> 4) ^ br_crc32c_nibbles[crc & 0x0F];
+	}
+
+	return (crc);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t br_crc32c_sse42(uint32_t crc, const uint8_t* data, size_t size)
+{
+	uint64_t wide = crc;
+	size_t i = 0;
+
+	for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+	{
+		uint64_t word = 0;
+		memcpy(&word, data + i, sizeof(word));
+		wide = _mm_crc32_u64(wide, word);
+	}
+
+	crc = (uint32_t) wide;
+	for(; i < size; i++) { crc = _mm_crc32_u8(crc, data[i]); }
+	return (crc);
+}
+#endif
+
+// the cpu is asked every time, which is a load and a test, so the predicate stays free of indirect calls
+inline static uint32_t br_crc32c(const uint8_t* data, size_t size)
+{
+	uint32_t function_value = 0;
+	bool hardware = false;
+
+#	if defined(__x86_64__)
+	hardware = (0 != __builtin_cpu_supports("sse4.2"));
+	if(true == hardware) { function_value = ~br_crc32c_sse42(~((uint32_t) 0), data, size); }
+#	endif
+
+	if(false == hardware) { function_value = ~br_crc32c_soft(~((uint32_t) 0), data, size); }
+	return (function_value);
+}
+
+inline static int br_check_crc32c(const uint8_t* data, size_t size)
+{
+	int function_value = BR_NOT_READY;
+	if(0 == size) { goto function_exit; }
+
+	// only whole lines are popped, so a line that does not check out is corrupt rather than unfinished
+	function_value = BR_TRUNCATE;
+	if(size < sizeof(uint32_t)) { goto function_exit; }
+
+	size_t payload = size - sizeof(uint32_t);
+	if(br_load_le32(data + payload) == br_crc32c(data, payload)) { function_value = BR_READY; }
+
+function_exit:
+	return (function_value);
+}
+
+// printable is 0x20 to 0x7E, tabs and line endings are let through as well since framed text keeps them
+inline static bool br_byte_is_printable(uint8_t byte)
+{
+	return (((0x20 <= byte) && (byte <= 0x7E)) || ('\t' == byte) || ('\n' == byte) || ('\r' == byte));
+}
+
+#if defined(__x86_64__)
+// sse2 is part of x86_64, so this needs no dispatch, bytes past 0x7F are negative and fail the first compare
+static size_t br_printable_prefix_sse2(const uint8_t* data, size_t size)
+{
+	size_t i = 0;
+	for(; i + sizeof(__m128i) <= size; i += sizeof(__m128i))
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+		__m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F)));
+		ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+		ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+		ok = _mm_or_si128(ok, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+		if(0xFFFF != _mm_movemask_epi8(ok)) { break; }
+	}
+
+	return (i);
+}
+
+__attribute__((target("avx2")))
+static size_t br_printable_prefix_avx2(const uint8_t* data, size_t size)
+{
+	size_t i = 0;
+	for(; i + sizeof(__m256i) <= size; i += sizeof(__m256i))
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+		__m256i ok = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1F)), _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7F), v));
+		ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+		ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+		ok = _mm256_or_si256(ok, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+		if(-1 != _mm256_movemask_epi8(ok)) { break; }
+	}
+
+	return (i);
+}
+#endif
+
+inline static int br_check_printable(const uint8_t* data, size_t size)
+{
+	int function_value = BR_NOT_READY;
+	size_t i = 0;
+	if(0 == size) { goto function_exit; }
+
+	// the vectors only skip ahead over what is known to be printable, the rest is checked a byte at a time
+#	if defined(__x86_64__)
+	if(0 != __builtin_cpu_supports("avx2")) { i = br_printable_prefix_avx2(data, size); }
+	i += br_printable_prefix_sse2(data + i, size - i);
+#	endif
+
+	function_value = BR_READY;
+	for(; i < size; i++)
+	{
+		if(false == br_byte_is_printable(data[i]))
+		{
+			function_value = BR_TRUNCATE;
+			break;
+		}
+	}
+
+function_exit:
+	return (function_value);
+}
+
+int br_ready_newline(const uint8_t* data, size_t size)
+{
+	return (br_check_terminated(data, size, '\n'));
+}
+
+int br_ready_nul(const uint8_t* data, size_t size)
+{
+	return (br_check_terminated(data, size, '\0'));
+}
+
+int br_ready_length_prefixed(const uint8_t* data, size_t size)
+{
+	return (br_check_length_prefixed(data, size));
+}
+
+int br_ready_crc32c(const uint8_t* data, size_t size)
+{
+	return (br_check_crc32c(data, size));
+}
+
+int br_ready_printable(const uint8_t* data, size_t size)
+{
+	return (br_check_printable(data, size));
+}
+
+// every caller of a br_ready_for_pop goes through here, the built in predicates are called directly instead of through f
+inline static int br_call_ready(br_ready_for_pop f, const uint8_t* data, size_t size)
+{
+	int function_value = 0;
+
+	if(br_ready_newline == f)							{ function_value = br_check_terminated(data, size, '\n'); }
+	else if(br_ready_nul == f)						{ function_value = br_check_terminated(data, size, '\0'); }
+	else if(br_ready_length_prefixed == f)	{ function_value = br_check_length_prefixed(data, size); }
+	else if(br_ready_crc32c == f)					{ function_value = br_check_crc32c(data, size); }
+	else if(br_ready_printable == f)			{ function_value = br_check_printable(data, size); }
+	else																	{ function_value = f(data, size); }
+
+	return (function_value);
+}
+
+int br_is_ready(byte_ring_t* ring, br_ready_for_pop f)
+{
+	return br_call_ready(f, br_peek_read_data(ring), br_get_size(ring, ring->read));
+}
+
+bool br_push(byte_ring_t* ring, uint8_t byte)
+{
+	bool function_value = false;
+
+	// the behavior comes from the flags, a function pointer would only be good in the process that set it
+	// lines are only written through br_claim_line in BR_CONCURRENT_MPSC, so those rings refuse
+	switch(br_get_push_behavior(ring))
+	{
+		case BR_OVERWRITE_OLDEST:
+			function_value = br_push_overwrite_oldest(ring, byte);
+			break;
+
+		case BR_OVERWRITE_NEWEST:
+			function_value = br_push_overwrite_newest(ring, byte);
+			break;
+
+		case BR_OVERWRITE_REFUSAL:
+			function_value = br_push_refuse_overwrite(ring, byte);
+			break;
+
+		default:
+			break;
+	}
+
+	return (function_value);
+}
+
+// callers that know their ring's behavior skip the dispatch, a ring with any other behavior is not touched
+bool br_push_oldest(byte_ring_t* ring, uint8_t byte)
+{
+	return ((BR_OVERWRITE_OLDEST == br_get_push_behavior(ring)) && (true == br_push_overwrite_oldest(ring, byte)));
+}
+
+bool br_push_newest(byte_ring_t* ring, uint8_t byte)
+{
+	return ((BR_OVERWRITE_NEWEST == br_get_push_behavior(ring)) && (true == br_push_overwrite_newest(ring, byte)));
+}
+
+bool br_push_refuse(byte_ring_t* ring, uint8_t byte)
+{
+	return ((BR_OVERWRITE_REFUSAL == br_get_push_behavior(ring)) && (true == br_push_refuse_overwrite(ring, byte)));
+}
+
+// same as br_write_reserve, for the behavior it is handed
+inline static size_t br_write_reserve_as(byte_ring_t* ring, size_t want, uint8_t** out, uint32_t behavior)
+{
+	size_t function_value = 0;
+	*out = NULL;
+
+	// a full line is handled exactly like br_push would before writing its next byte
+	if(false == br_prepare_write_as(ring, behavior)) { goto function_exit; }
+
+	size_t size = br_peek_write_size(ring);
+	function_value = ring->line_length - size;
+	if(want < function_value) { function_value = want; }
+	*out = br_get_line(ring, ring->write) + size;
+
+function_exit:
+	return (function_value);
+}
+
+inline static size_t br_push_bytes_as(byte_ring_t* ring, const uint8_t* src, size_t n, uint32_t behavior)
+{
+	size_t accepted = 0;
+
+	// one behavior check and one copy per line instead of per byte
+	while(accepted < n)
+	{
+		uint8_t* dst = NULL;
+		size_t chunk = br_write_reserve_as(ring, n - accepted, &dst, behavior);
+		if(0 == chunk) { break; }
+
+		memcpy(dst, src + accepted, chunk);
+		br_write_commit(ring, chunk);
+		accepted += chunk;
+
+		// br_push checks for clobber before every byte, checking once per line keeps the event flags identical
+		if(1 < chunk) { br_write_will_point_to_read(ring); }
+	}
+
+	br_check_truths(ring);
+	return (accepted);
+}
+
+size_t br_push_bytes(byte_ring_t* ring, const uint8_t* src, size_t n)
+{
+	return (br_push_bytes_as(ring, src, n, br_get_push_behavior(ring)));
+}
+
+size_t br_push_bytes_oldest(byte_ring_t* ring, const uint8_t* src, size_t n)
+{
+	size_t function_value = 0;
+	if(BR_OVERWRITE_OLDEST == br_get_push_behavior(ring)) { function_value = br_push_bytes_as(ring, src, n, BR_OVERWRITE_OLDEST); }
+	return (function_value);
+}
+
+size_t br_push_bytes_newest(byte_ring_t* ring, const uint8_t* src, size_t n)
+{
+	size_t function_value = 0;
+	if(BR_OVERWRITE_NEWEST == br_get_push_behavior(ring)) { function_value = br_push_bytes_as(ring, src, n, BR_OVERWRITE_NEWEST); }
+	return (function_value);
+}
+
+size_t br_push_bytes_refuse(byte_ring_t* ring, const uint8_t* src, size_t n)
+{
+	size_t function_value = 0;
+	if(BR_OVERWRITE_REFUSAL == br_get_push_behavior(ring)) { function_value = br_push_bytes_as(ring, src, n, BR_OVERWRITE_REFUSAL); }
+	return (function_value);
+}
+
+size_t br_push_framed(byte_ring_t* ring, const uint8_t* src, size_t n, uint8_t delimiter)
+{
+	size_t accepted = 0;
+
+	while(accepted < n)
+	{
+		// libc's memchr already scans a vector at a time, so only frame boundaries cost a branch
+		const uint8_t* found = (const uint8_t*) memchr(src + accepted, delimiter, n - accepted);
+		size_t frame = n - accepted;
+		if(NULL != found) { frame = (size_t) (found - (src + accepted)) + sizeof(delimiter); }
+
+		size_t pushed = br_push_bytes(ring, src + accepted, frame);
+		accepted += pushed;
+		if(pushed < frame) { break; }
+
+		if((NULL != found) && (false == br_advance_write_head(ring))) { break; }
+	}
+
+	return (accepted);
+}
+
+size_t br_write_reserve(byte_ring_t* ring, size_t want, uint8_t** out)
+{
+	return (br_write_reserve_as(ring, want, out, br_get_push_behavior(ring)));
+}
+
+size_t br_write_commit(byte_ring_t* ring, size_t n)
+{
+	size_t size = br_peek_write_size(ring);
+	size_t index = br_get_slot(ring, ring->write);
+	size_t room = ring->line_length - size;
+	if(room < n) { n = room; }
+
+	br_set_size(ring, index, size + n);
+	br_count_written(ring, n);
+	br_stats_count_pushed(ring, n);
+	br_check_truths(ring);
+	return (n);
+}
+
+//bool br_cinch(byte_ring_t* ring, uint8_t byte)
+//{
+//	size_t size = br_get_size(ring, ring->write);
+//	//size_t index = br_get_size_map_index(ring, ring->write);
+//	
+//	if((ring->line_length - size - sizeof(byte) > ring->line_length)
+//		|| (ring->line_length - size - sizeof(byte) < 0))
+//	{
+//		goto function_exit;
+//	}
+//	
+//	// block overwrite with byte for however many is left, without the last one
+//	memset(ring->write + size, (int) byte, (ring->line_length - size - sizeof(byte)) * sizeof(byte));
+//	
+//	// don't adjust the counter, since this is dummy data
+//	// leave a space for the final push
+//	//br_set_size(ring, index, ring->line_length - 1);
+//	
+//	// then try to increment head according to behavior with the final byte being pushed
+//function_exit:
+//	return ring->push_function(ring, byte);
+//}
+//
+//bool br_cinch00(byte_ring_t* ring)
+//{
+//	return br_cinch(ring, 0x00);
+//}
+//
+//bool br_cinchFF(byte_ring_t* ring)
+//{
+//	return br_cinch(ring, 0xFF);
+//}
+
+bool br_advance_write_head(byte_ring_t* ring)
+{
+	bool function_value		= false;
+
+	// there is no shared write line with several producers, br_commit_line publishes instead
+	// checked first, the producer side state br_write_will_point_to_read touches belongs to nobody then
+	if(true == br_is_multi_producer(ring)) { goto function_exit; }
+
+	// moving the write head onto the read head is an overwrite no matter how full the line is
+	bool overwrite			= br_write_will_point_to_read(ring);
+
+	if(false == overwrite)
+	{
+		br_move_write_line_forward(ring);
+		function_value = true;
+	}
+		
+	if(true == overwrite)
+	{
+		switch(_br_get_immutable_flags(ring) & BR_OVERWRITE_FLAGS_MASK)
+		{
+				case BR_OVERWRITE_OLDEST:
+					{
+						// same as br_prepare_overwrite_oldest
+						while(true == overwrite)
+						{
+							br_trace(ring, BR_TRACE_OVERWRITE, ring->read, br_get_size(ring, ring->read));
+							br_move_read_line_forward(ring);
+							br_stats_count_overwrite(ring, BR_OVERWRITE_OLDEST);
+							overwrite = br_write_will_point_to_read(ring);
+						}
+
+						br_move_write_line_forward(ring);
+						_br_add_producer_flags(ring, BR_FLAG_OVERWRITE);
+						function_value = true;
+					}
+				break;
+				
+				case BR_OVERWRITE_NEWEST:
+					{
+						br_trace(ring, BR_TRACE_OVERWRITE, ring->write, br_get_size(ring, ring->write));
+						br_reset_write_head(ring);
+						_br_add_producer_flags(ring, BR_FLAG_OVERWRITE);
+						br_stats_count_overwrite(ring, BR_OVERWRITE_NEWEST);
+						function_value = true;
+					}
+				break;
+				
+				case BR_OVERWRITE_REFUSAL:
+					{
+						br_trace(ring, BR_TRACE_REFUSAL, ring->write, br_get_size(ring, ring->write));
+						br_stats_count_refusal(ring);
+						function_value = false;
+					}
+				break;
+		}
+	}	
+	
+	_br_add_producer_flags(ring, BR_FLAG_DATA_READY);
+function_exit:
+	return (function_value);
+}
+
+bool br_flush(byte_ring_t* ring)
+{
+	bool function_value = false;
+	if(false == br_is_batched(ring)) { goto function_exit; }
+	function_value = br_publish(ring);
+
+function_exit:
+	return (function_value);
+}
+
+bool br_set_publish_batch(byte_ring_t* ring, size_t lines, uint64_t max_delay_ns)
+{
+	bool function_value = false;
+	if((false == br_is_batched(ring)) || (0 == lines) || (UINT32_MAX < lines)) { goto function_exit; }
+
+	ring->batch_limit			= (uint32_t) lines;
+	ring->batch_delay_ns	= max_delay_ns;
+	ring->batch_started		= br_get_monotonic_ns();
+	function_value				= true;
+
+	// a smaller batch may already be due
+	if(ring->batch_limit <= ring->batch_lines) { br_publish(ring); }
+
+function_exit:
+	return (function_value);
+}
+
+bool br_seek(byte_ring_t* ring)
+{
+	bool function_value = false;
+	br_reset_read_head(ring);
+	bool clobber = br_read_will_point_to_write(ring);
+	
+	if(false == clobber)
+	{
+		br_move_read_line_forward(ring);
+		function_value = true;
+	}
+	
+	return (function_value);
+}
+
+void br_clear(byte_ring_t* ring)
+{
+	// nothing reads past a line's size, so the old data can stay where it is
+#	ifndef BR_SHRED_OLD_DATA
+	br_trace(ring, BR_TRACE_CLEAR, ring->write, br_bytes_used(ring));
+	br_reset_cursors(ring);
+#	endif
+
+#	ifdef BR_SHRED_OLD_DATA
+	br_clear_secure(ring);
+#	endif
+}
+
+void br_clear_secure(byte_ring_t* ring)
+{
+	br_trace(ring, BR_TRACE_CLEAR, ring->write, br_bytes_used(ring));
+
+	// same passes as br_reset_read_line
+	size_t size = br_get_backing_store_size(ring);
+	uint8_t* backing_store = br_get_first_line(ring);
+	memset(backing_store, 0xA5, size * sizeof(uint8_t));
+	memset(backing_store, 0x5A, size * sizeof(uint8_t));
+
+	br_wipe(ring);
+}
+
+void br_set_flag(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
+{
+	_br_add_flags(ring, event_flag & BR_EVENT_FLAGS_MASK);
+}
+
+void br_clear_flag(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
+{
+	_br_clear_flag(ring, event_flag & BR_EVENT_FLAGS_MASK);
+}
+
+bool br_flag_is_set(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
+{
+	uint32_t flags = _br_get_flags(ring);
+	return (0 != (event_flag & flags));
+}
+
+ssize_t br_pop(byte_ring_t* ring, uint8_t* dst, br_ready_for_pop f)
+{
+	size_t size = br_get_size(ring, ring->read);
+	ssize_t function_value = 0;
+	int action = br_call_ready(f, br_peek_read_data(ring), size);
 	
-	_br_set_flags(ring, 0);
-	_br_add_flags(ring, BR_BACKING_STORE_ALLOC | BR_STRUCT_ALLOC | BR_SIZEMAP_ALLOC | behavior_flag);
+	if(BR_NOT_READY == action)
+	{
+		goto function_exit;
+	}
 
-	switch(behavior_flag)
+	if(BR_TRUNCATE == action)
 	{
-		case BR_OVERWRITE_OLDEST:
-			ring->push_function = br_push_overwrite_oldest;
-			break;
+		br_trace(ring, BR_TRACE_TRUNCATE, ring->read, size);
+		br_stats_count_truncation(ring);
+		br_seek(ring);
+		function_value = -1;
+		goto function_exit;
+	}
 
-		case BR_OVERWRITE_NEWEST:
-			ring->push_function = br_push_overwrite_newest;
-			break;
+	if(BR_READY == action)
+	{
+		memcpy(dst, br_peek_read_data(ring), size);
+		function_value = size;
+		br_stats_count_popped(ring, 1);
+		br_seek(ring);
+		goto function_exit;
+	}
 
-		case BR_OVERWRITE_REFUSAL:
-			ring->push_function = br_push_refuse_overwrite;
-			break;
+function_exit:
+	return function_value;
+}
 
-		default:
-			break;
+ssize_t br_fill_from_fd(byte_ring_t* ring, int fd, size_t max)
+{
+	struct iovec iov[BR_IOV_MAX];
+	ssize_t function_value = -1;
+	size_t count = 0;
+	size_t room = 0;
+
+	if(0 == max) { function_value = 0; goto function_exit; }
+
+	// the behavior only decides on the write line, the same way it would before br_push writes a byte
+	if(false == br_prepare_write(ring))
+	{
+		errno = ENOBUFS;
+		goto function_exit;
 	}
 
-	br_clear(ring);
-fail_early:
-	return ring;
+	// every line after the write line has to be free already, nothing is overwritten to make room for the read
+	ring->cached_read = br_load_head(&(ring->read));
+	uint64_t line = ring->write;
+	size_t size = br_peek_write_size(ring);
+	uint64_t offset = (true == br_is_packed(ring)) ? br_get_offset_map(ring)[br_get_slot(ring, line)] : 0;
+
+	while((room < max) && (count < BR_IOV_MAX))
+	{
+		size_t length = ring->line_length - size;
+		if(max - room < length) { length = max - room; }
+
+		iov[count].iov_base	= br_get_line(ring, line) + size;
+		iov[count].iov_len	= length;
+		room += length;
+		++ count;
+
+		uint64_t next_offset = (true == br_is_packed(ring)) ? br_get_offset_after(ring, offset, ring->line_length) : 0;
+		if(true == br_ring_looks_full_after(ring, line, next_offset)) { break; }
+
+		// br_get_line only finds packed lines through the offset map, the entry is written again when the line is reached
+		++ line;
+		size = 0;
+		offset = next_offset;
+		if(true == br_is_packed(ring)) { br_get_offset_map(ring)[br_get_slot(ring, line)] = offset; }
+	}
+
+	function_value = readv(fd, iov, (int) count);
+	if(function_value <= 0) { goto function_exit; }
+
+	// the lines are taken the same way br_push_bytes takes them, the last one stays the write line even when it is full
+	size_t left = (size_t) function_value - br_write_commit(ring, (size_t) function_value);
+	while(0 != left)
+	{
+		_br_add_producer_flags(ring, BR_FLAG_LINE_WRAPPED);
+		br_move_write_line_forward(ring);
+		left -= br_write_commit(ring, left);
+	}
+
+	br_write_will_point_to_read(ring);
+
+function_exit:
+	return (function_value);
 }
 
-byte_ring_t* br_create_alloc_static_backing_store(size_t n_lines,
-		size_t len_lines, BR_BEHAVIOR_FLAGS behavior_flag,
-		uint8_t* backing_store)
+ssize_t br_drain_to_fd(byte_ring_t* ring, int fd, size_t max_lines)
 {
-	byte_ring_t* ring					= (byte_ring_t*) malloc(sizeof(byte_ring_t));
-	if(NULL == ring) { goto fail_early; }
+	struct iovec iov[BR_IOV_MAX];
+	ssize_t function_value = 0;
+	size_t count = 0;
+	size_t lines = 0;
+	uint64_t line = ring->read;
 
-	size_t* size_map					= (size_t*) malloc(sizeof(size_t) * n_lines);
-	if(NULL == size_map)
+	// empty lines are passed over without an iovec, the read line is empty once it has been popped
+	while((count < max_lines) && (count < BR_IOV_MAX))
 	{
-		free(ring);
-		ring = NULL;
-		goto fail_early;
+		size_t size = br_get_size(ring, line);
+		if(0 != size)
+		{
+			iov[count].iov_base	= br_get_line(ring, line);
+			iov[count].iov_len	= size;
+			++ count;
+		}
+
+		++ lines;
+		if(true == br_line_is_last(ring, line)) { break; }
+		++ line;
 	}
 
-	ring->size_map						=	size_map;
-	ring->backing_store				= backing_store;
-	ring->backing_store_size	= n_lines * len_lines;
-	ring->number_lines				= n_lines;
-	ring->line_length					= len_lines;
-	
-	_br_set_flags(ring, 0);
-	_br_add_flags(ring, BR_STRUCT_ALLOC | BR_SIZEMAP_ALLOC | behavior_flag);
+	if(0 != count) { function_value = writev(fd, iov, (int) count); }
+	if(function_value < 0) { goto function_exit; }
 
-	switch(behavior_flag)
+	// every line that went out whole is released, and the rest of a line that went out in part stays the read line
+	size_t left = (size_t) function_value;
+	size_t sent = 0;
+	for(line = ring->read; sent < lines; ++line, ++sent)
 	{
-		case BR_OVERWRITE_OLDEST:
-			ring->push_function = br_push_overwrite_oldest;
-			break;
+		if(left < br_get_size(ring, line)) { break; }
+		left -= br_get_size(ring, line);
+	}
 
-		case BR_OVERWRITE_NEWEST:
-			ring->push_function = br_push_overwrite_newest;
-			break;
+	br_read_release_lines(ring, sent);
+	if(0 == left) { goto function_exit; }
 
-		case BR_OVERWRITE_REFUSAL:
-			ring->push_function = br_push_refuse_overwrite;
-			break;
+	size_t slot = br_get_slot(ring, ring->read);
+	size_t size = br_get_size(ring, ring->read);
+	uint8_t* data = br_get_line(ring, ring->read);
+	memmove(data, data + left, size - left);
 
-		default:
-			break;
+#	ifdef BR_SHRED_OLD_DATA
+	memset(data + size - left, 0, left * sizeof(uint8_t));
+#	endif
+
+	br_count_released(ring, left);
+	br_set_size(ring, slot, (size - left) | (br_get_size_entry(ring, slot) & ring->line_committed));
+
+function_exit:
+	return (function_value);
+}
+
+#ifdef __linux__
+inline static void br_cpu_relax(void)
+{
+#	if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#	endif
+}
+
+// milliseconds left until deadline, never below 0
+inline static int64_t br_get_remaining_ms(const struct timespec* deadline)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	int64_t function_value = (int64_t) (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+	if(function_value < 0) { function_value = 0; }
+	return (function_value);
+}
+
+// sleeps until a producer publishes a line or the deadline passes, gives up when the timeout ran out
+static bool br_park(byte_ring_t* ring, int timeout_ms, const struct timespec* deadline)
+{
+	bool function_value = false;
+
+	while(false == function_value)
+	{
+		// the sequence is read before the last look, so a wake in between makes the futex return at once
+		uint32_t sequence = __atomic_load_n(&(ring->wake_sequence), __ATOMIC_ACQUIRE);
+		__atomic_fetch_or(&(ring->waiting), BR_WAITING_FUTEX, __ATOMIC_SEQ_CST);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+		function_value = (false == br_line_is_last(ring, ring->read));
+		if(true == function_value) { break; }
+
+		int64_t remaining = br_get_remaining_ms(deadline);
+		if((0 <= timeout_ms) && (0 == remaining)) { break; }
+
+		struct timespec relative = { (time_t) (remaining / 1000), (long) ((remaining % 1000) * 1000000) };
+		syscall(SYS_futex, &(ring->wake_sequence), br_get_futex_op(ring, FUTEX_WAIT), sequence,
+			(0 <= timeout_ms) ? &relative : NULL, NULL, 0);
 	}
 
-	br_clear(ring);
-fail_early:
-	return ring;
+	__atomic_fetch_and(&(ring->waiting), ~BR_WAITING_FUTEX, __ATOMIC_RELAXED);
+	return (function_value);
 }
 
-int br_alloc_full_static(byte_ring_t* ring, size_t n_lines, size_t len_lines,
-		BR_BEHAVIOR_FLAGS behavior_flag, uint8_t* backing_store)
+// returns true once there is a line past the read line, false when the timeout ran out first
+static bool br_wait_for_line(byte_ring_t* ring, int timeout_ms, const struct timespec* deadline)
 {
-	int function_value				=	-1;
-	ring->backing_store				= backing_store;
-	ring->backing_store_size	= n_lines * len_lines;
-	ring->number_lines				= n_lines;
-	ring->line_length					= len_lines;
-	
-	_br_set_flags(ring, 0);
-	_br_add_flags(ring, BR_SIZEMAP_ALLOC | behavior_flag);
+	bool function_value = false;
+
+	// spinning pays off under load, so the budget doubles when it worked and halves when the consumer had to park
+	for(uint32_t i = 0; (0 != timeout_ms) && (i < ring->spin_budget); i++)
+	{
+		if(false == br_line_is_last(ring, ring->read))
+		{
+			if(ring->spin_budget < BR_WAIT_SPINS_MAX) { ring->spin_budget *= 2; }
+			function_value = true;
+			goto function_exit;
+		}
+
+		br_cpu_relax();
+	}
+
+	if(BR_WAIT_SPINS_MIN < ring->spin_budget) { ring->spin_budget /= 2; }
+
+	if(0 != (_br_get_immutable_flags(ring) & BR_WAITABLE))
+	{
+		function_value = br_park(ring, timeout_ms, deadline);
+		goto function_exit;
+	}
+
+	// the producers never wake a ring that is not BR_WAITABLE, so it can only be polled
+	while(false == function_value)
+	{
+		function_value = (false == br_line_is_last(ring, ring->read));
+		if((true == function_value) || ((0 <= timeout_ms) && (0 == br_get_remaining_ms(deadline)))) { break; }
+		sched_yield();
+	}
+
+function_exit:
+	return (function_value);
+}
+
+ssize_t br_pop_wait(byte_ring_t* ring, uint8_t* dst, br_ready_for_pop f, int timeout_ms)
+{
+	ssize_t function_value = 0;
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec		+= timeout_ms / 1000;
+	deadline.tv_nsec	+= (long) (timeout_ms % 1000) * 1000000;
+	if(1000000000 <= deadline.tv_nsec) { deadline.tv_sec += 1; deadline.tv_nsec -= 1000000000; }
+
+	while(true)
+	{
+		function_value = br_pop(ring, dst, f);
+		if(0 != function_value) { break; }
+
+		// published lines are whole, so waiting cannot change the mind of an f that is not ready for one
+		if(0 != br_peek_read_size(ring)) { break; }
+
+		// the read line was already consumed, the next line may be there already
+		if(true == br_seek(ring)) { continue; }
+		if(false == br_wait_for_line(ring, timeout_ms, &deadline)) { break; }
+	}
+
+	return (function_value);
+}
+
+int br_get_notify_fd(byte_ring_t* ring)
+{
+	// a fd another process opened cannot be used here, the consumer's process takes over the notification
+	if((-1 == ring->notify_fd) || (getpid() != ring->notify_pid))
+	{
+		ring->notify_fd					= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		ring->notify_pid				= getpid();
+	}
+
+	return (ring->notify_fd);
+}
+
+bool br_arm_notify_fd(byte_ring_t* ring)
+{
+	uint64_t count = 0;
+	bool function_value = false;
+	if(-1 == br_get_notify_fd(ring)) { goto function_exit; }
+
+	// a stale count would wake the caller for lines it already popped
+	ssize_t drained = read(ring->notify_fd, &count, sizeof(count));
+	(void) drained;
+
+	__atomic_fetch_or(&(ring->waiting), BR_WAITING_FD, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	// same last look as br_park
+	function_value = br_line_is_last(ring, ring->read);
+	if(false == function_value) { __atomic_fetch_and(&(ring->waiting), ~BR_WAITING_FD, __ATOMIC_RELAXED); }
+
+function_exit:
+	return (function_value);
+}
+#endif
+
+bool br_read_acquire(byte_ring_t* ring, br_span_t* span)
+{
+	span->data = br_peek_read_data(ring);
+	span->size = br_peek_read_size(ring);
+	return (0 != span->size);
+}
+
+bool br_read_release(byte_ring_t* ring)
+{
+	// the line is only invalidated here, so a borrowed span stays intact until now
+	if(0 != br_peek_read_size(ring)) { br_stats_count_popped(ring, 1); }
+	return (br_seek(ring));
+}
+
+ssize_t br_pop_view(byte_ring_t* ring, br_span_t* span, br_ready_for_pop f)
+{
+	size_t size = br_get_size(ring, ring->read);
+	ssize_t function_value = 0;
+	int action = br_call_ready(f, br_peek_read_data(ring), size);
+
+	if(BR_NOT_READY == action)
+	{
+		goto function_exit;
+	}
+
+	if(BR_TRUNCATE == action)
+	{
+		br_trace(ring, BR_TRACE_TRUNCATE, ring->read, size);
+		br_stats_count_truncation(ring);
+		br_seek(ring);
+		function_value = -1;
+		goto function_exit;
+	}
+
+	if(BR_READY == action)
+	{
+		span->data = br_peek_read_data(ring);
+		span->size = size;
+		function_value = size;
+		goto function_exit;
+	}
+
+function_exit:
+	return function_value;
+}
+
+uint8_t* br_claim_line(byte_ring_t* ring)
+{
+	uint8_t* function_value = NULL;
+	uint64_t ticket = __atomic_load_n(&(ring->write), __ATOMIC_RELAXED);
+	uint64_t read = 0;
+	if(false == br_is_multi_producer(ring)) { goto function_exit; }
+
+	// the heads only ever grow, so the compare and swap cannot be fooled by the ring wrapping
+	do
+	{
+		// same full rule as br_write_will_point_to_read
+		read = br_load_head(&(ring->read));
+		if(ring->number_lines - 1 <= ticket - read)
+		{
+			_br_add_producer_flags(ring, BR_FLAG_RING_FULL);
+			br_trace(ring, BR_TRACE_REFUSAL, ticket, 0);
+			br_stats_count_refusal(ring);
+			goto function_exit;
+		}
+	}
+	while(false == __atomic_compare_exchange_n(&(ring->write), &ticket, ticket + 1,
+		true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	br_stats_count_waiting(ring, ticket - read, true);
+	function_value = br_get_line(ring, ticket);
+function_exit:
+	return (function_value);
+}
+
+void br_commit_line(byte_ring_t* ring, uint8_t* line, size_t size)
+{
+	size_t index = br_get_line_index(ring, line);
+	if(ring->line_length < size) { size = ring->line_length; }
+
+	// the line's data is published to the consumer along with its size
+	br_trace(ring, BR_TRACE_LINE_ADVANCE, index, size);
+	br_count_written(ring, size);
+	br_stats_count_pushed(ring, size);
+	br_stats_count_published(ring, size);
+	br_store_size_entry(ring, index, size | ring->line_committed);
+	_br_add_producer_flags(ring, BR_FLAG_DATA_READY);
+	br_notify_consumer(ring);
+}
+
+ssize_t br_push_line(byte_ring_t* ring, const uint8_t* src, size_t n)
+{
+	ssize_t function_value = -1;
+	uint8_t* line = br_claim_line(ring);
+	if(NULL == line) { goto function_exit; }
+
+	if(ring->line_length < n) { n = ring->line_length; }
+	memcpy(line, src, n);
+	br_commit_line(ring, line, n);
+	function_value = n;
+
+function_exit:
+	return (function_value);
+}
 
-	size_t* size_map					= (size_t*) malloc(sizeof(size_t) * n_lines);
-	if(NULL == size_map)
-	{
-		goto function_exit;
-	}
+size_t br_pop_batch(byte_ring_t* ring, br_span_t* spans, size_t max, br_ready_for_pop f)
+{
+	size_t function_value = 0;
 
-	ring->size_map						=	size_map;
-	switch(behavior_flag)
+	// the read line is empty once it has been popped or released, so the batch starts at the line after it
+	if(0 == br_get_size(ring, ring->read)) { br_seek(ring); }
+	uint64_t line = ring->read;
+
+	while(function_value < max)
 	{
-		case BR_OVERWRITE_OLDEST:
-			ring->push_function = br_push_overwrite_oldest;
-			break;
+		size_t size = br_get_size(ring, line);
+		int action = br_call_ready(f, br_get_line(ring, line), size);
 
-		case BR_OVERWRITE_NEWEST:
-			ring->push_function = br_push_overwrite_newest;
-			break;
+		// nothing has been handed out yet, so a truncated line can be dropped on the spot
+		if((BR_TRUNCATE == action) && (0 == function_value))
+		{
+			br_trace(ring, BR_TRACE_TRUNCATE, line, size);
+			br_stats_count_truncation(ring);
+			if(false == br_seek(ring)) { break; }
+			line = ring->read;
+			continue;
+		}
 
-		case BR_OVERWRITE_REFUSAL:
-			ring->push_function = br_push_refuse_overwrite;
-			break;
+		if(BR_READY != action) { break; }
 
-		default:
-			break;
+		spans[function_value].data = br_get_line(ring, line);
+		spans[function_value].size = size;
+		++ function_value;
+
+		if(true == br_line_is_last(ring, line)) { break; }
+		++ line;
 	}
 
-	br_clear(ring);
-	function_value = 0;
-function_exit:
-	return function_value;
+	return (function_value);
 }
 
-void br_destroy_internals(byte_ring_t* ring)
+size_t br_read_release_lines(byte_ring_t* ring, size_t n)
 {
-	uint32_t alloc_map = _br_get_flags(ring) & BR_ALLOC_FLAGS_MASK;
-	uint8_t* backing_store = br_get_first_line(ring);
+	uint64_t line = ring->read;
+	size_t function_value = 0;
 
-	if(BR_BACKING_STORE_ALLOC & alloc_map)
+	// the same as n calls to br_read_release, except the read head is published once
+	for(size_t i = 0; i < n; i++)
 	{
-		free(backing_store);
-		ring->backing_store = NULL;
+		if(0 != br_get_size(ring, line)) { br_stats_count_popped(ring, 1); }
+		br_reset_read_line(ring, line);
+
+		if(true == br_line_is_last(ring, line))
+		{
+			_br_add_consumer_flags(ring, BR_FLAG_RING_EMPTY);
+			break;
+		}
+
+		++ line;
+		++ function_value;
 	}
 
-	if(BR_SIZEMAP_ALLOC & alloc_map)
+	if(0 != function_value)
 	{
-		free(ring->size_map);
-		ring->size_map = NULL;
+		br_store_head(&(ring->read), line);
 	}
+
+	br_check_truths(ring);
+	return (function_value);
 }
 
-void br_destroy(byte_ring_t** ring)
+struct br_pool
 {
-	br_destroy_internals(*ring);
+	// the free rings form a stack, linked through next by index
+	// top holds the index of the top ring plus 1, 0 when the stack is empty, with a tag in the upper half
+	// every change bumps the tag, so a ring taken and put back between another thread's load and compare and swap
+	// cannot make that compare and swap succeed
+	_Alignas(BR_CACHE_LINE_SIZE)
+	uint64_t								top;
+
+	_Alignas(BR_CACHE_LINE_SIZE)
+	uint32_t*								next;
+	uint8_t*								arena;
+	size_t									ring_size;
+	size_t									number_rings;
+};
 
-	uint32_t alloc_map = _br_get_flags(*ring) & BR_ALLOC_FLAGS_MASK;
-	if(BR_STRUCT_ALLOC & alloc_map) { free(*ring); *ring = NULL; }
+#define BR_POOL_INDEX_MASK				((uint64_t) UINT32_MAX)
+#define BR_POOL_TAG_ONE					(((uint64_t) 1) << 32)
+
+inline static byte_ring_t* br_pool_get_ring(br_pool_t* pool, uint32_t index)
+{
+	return ((byte_ring_t*) (pool->arena + (index * pool->ring_size)));
 }
 
-#ifdef BR_STDIO_DEBUG
-void br_dump_contents(byte_ring_t* ring)
+inline static void br_pool_push(br_pool_t* pool, uint32_t index)
 {
-	uint8_t* line = br_get_first_line(ring);
+	uint64_t top = __atomic_load_n(&(pool->top), __ATOMIC_RELAXED);
+	uint64_t next = 0;
 
-	while(line <= br_get_final_line(ring))
+	do
 	{
-		for(size_t i = 0; i < ring->line_length; i++)
-		{
-			printf("%.2X", line[i]);
-		}
-		puts("");
-
-		if(br_get_final_line(ring) == line)
-		{
-			break;
-		}
-
-		line = br_get_next_line(ring, line);
+		__atomic_store_n(&(pool->next[index]), (uint32_t) (top & BR_POOL_INDEX_MASK), __ATOMIC_RELAXED);
+		next = ((top & ~BR_POOL_INDEX_MASK) + BR_POOL_TAG_ONE) | (index + 1);
 	}
+	// release, whoever takes the ring next sees it reset
+	while(false == __atomic_compare_exchange_n(&(pool->top), &top, next,
+		true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 }
 
-void br_print_configuration(byte_ring_t* ring)
+br_pool_t* br_pool_create(size_t n_rings, size_t n_lines, size_t len_lines, BR_BEHAVIOR_FLAGS behavior_flag)
 {
-	size_t bs_size = br_get_backing_store_size(ring);
-	printf("number lines: %zu\n", ring->number_lines);
-	printf("line length: %zu\n", ring->line_length);
-	printf("backing store size: %zu\n", bs_size);
-	printf("allocation map: %u\n", ring->alloc_map);
-	
-	printf("overwrite mode: ");
-	switch(ring->behavior)
+	br_pool_t* pool						= NULL;
+	if((0 == n_rings) || (UINT32_MAX <= n_rings)) { goto fail_early; }
+
+	pool											= (br_pool_t*) aligned_alloc(BR_CACHE_LINE_SIZE, sizeof(br_pool_t));
+	if(NULL == pool) { goto fail_early; }
+
+	pool->ring_size						= br_required_size(n_lines, len_lines);
+	pool->number_rings				= n_rings;
+	pool->top									= 0;
+	pool->arena								= (uint8_t*) aligned_alloc(BR_CACHE_LINE_SIZE, n_rings * pool->ring_size);
+	pool->next								= (uint32_t*) malloc(sizeof(uint32_t) * n_rings);
+	if((NULL == pool->arena) || (NULL == pool->next)) { goto fail_late; }
+
+	// every ring of the arena is built once, from then on it is only reset
+	for(size_t i = 0; i < n_rings; i++)
 	{
-		case BR_OVERWRITE_REFUSAL:
-		printf("refused\n");
-		break;
-		case BR_OVERWRITE_NEWEST:
-		printf("newest\n");
-		break;
-		case BR_OVERWRITE_OLDEST:
-		printf("oldest\n");
-		break;
+		byte_ring_t* ring = br_create_in_place(br_pool_get_ring(pool, (uint32_t) i), pool->ring_size,
+			n_lines, len_lines, behavior_flag);
+		if(NULL == ring) { goto fail_late; }
+
+		// the arena is the pool's own, nothing but this process gets to see the ring
+		_br_add_flags(ring, BR_POOL_RING);
 	}
 
-	puts("");
+	// pushed in reverse, so the rings are handed out in the order they sit in the arena
+	for(size_t i = n_rings; 0 < i; i--)
+	{
+		br_pool_push(pool, (uint32_t) (i - 1));
+	}
+
+	goto fail_early;
+fail_late:
+	free(pool->arena);
+	free(pool->next);
+	free(pool);
+	pool = NULL;
+fail_early:
+	return pool;
+}
+
+void br_pool_destroy(br_pool_t** pool)
+{
+	free((*pool)->arena);
+	free((*pool)->next);
+	free(*pool);
+	*pool = NULL;
+}
+
+byte_ring_t* br_pool_get(br_pool_t* pool)
+{
+	byte_ring_t* function_value = NULL;
+	uint64_t top = __atomic_load_n(&(pool->top), __ATOMIC_ACQUIRE);
+	uint64_t next = 0;
 
-	size_t counter = 0;
-	uint8_t* line = br_get_first_line(ring);
-	size_t size = br_get_size(ring, line);
 	do
 	{
-		printf("line: %zu @ %p, size: %zu\n", counter, line, size);
-		++ counter;
-		line = br_get_next_line(ring, line);
-		size = br_get_size(ring, line);
+		if(0 == (top & BR_POOL_INDEX_MASK)) { goto function_exit; }
+
+		// next may already be stale, then the tag has moved on and the compare and swap fails
+		uint32_t index = (uint32_t) (top & BR_POOL_INDEX_MASK) - 1;
+		next = ((top & ~BR_POOL_INDEX_MASK) + BR_POOL_TAG_ONE) | __atomic_load_n(&(pool->next[index]), __ATOMIC_RELAXED);
 	}
-	while(counter < ring->number_lines);
+	while(false == __atomic_compare_exchange_n(&(pool->top), &top, next,
+		true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+	function_value = br_pool_get_ring(pool, (uint32_t) (top & BR_POOL_INDEX_MASK) - 1);
+function_exit:
+	return (function_value);
 }
-#endif
 
-size_t br_peek_read_size(byte_ring_t* ring)
+void br_pool_put(br_pool_t* pool, byte_ring_t* ring)
 {
-	return br_get_size(ring, ring->read);
+	uint32_t index = (uint32_t) (((uint8_t*) ring - pool->arena) / pool->ring_size);
+
+	// the data left in the ring is never read again, only the heads and the event flags need resetting
+	br_clear(ring);
+	br_pool_push(pool, index);
 }
 
-inline const uint8_t* br_peek_read_data(byte_ring_t* ring)
+struct br_selector
 {
-	const uint8_t* peek = ring->read;
-	return peek;
-}
+	// set up by br_selector_create, after that only read
+	// ready holds one bit per slot, raised by the producer of the ring in it and lowered by the consumer
+	// a producer only writes a word while its bit is down, so rings that stay busy leave the word shared
+	_Alignas(BR_CACHE_LINE_SIZE)
+	uint64_t*								ready;
+	byte_ring_t**						rings;
+	uint32_t*								weights;
+	size_t									number_slots;
+	size_t									number_words;
+
+	// owned by the consumer, the slot whose turn it is and how many more times its ring is handed out in the turn
+	_Alignas(BR_CACHE_LINE_SIZE)
+	size_t									current;
+	uint32_t								credit;
+};
 
-inline size_t br_peek_write_size(byte_ring_t* ring)
+#define BR_SELECTOR_WORD_BITS			64
+
+inline static uint64_t* br_selector_get_word(br_selector_t* selector, size_t slot)
 {
-	return br_get_size(ring, ring->write);
+	return (&(selector->ready[slot / BR_SELECTOR_WORD_BITS]));
 }
 
-inline const uint8_t* br_peek_write_data(byte_ring_t* ring)
+inline static uint64_t br_selector_get_bit(size_t slot)
 {
-	const uint8_t* peek = ring->write;
-	return peek;
+	return (((uint64_t) 1) << (slot % BR_SELECTOR_WORD_BITS));
 }
 
-int br_is_ready(byte_ring_t* ring, br_ready_for_pop f)
+// called by a producer after it published lines, behind the fence in br_notify_consumer
+static void br_selector_raise(br_selector_t* selector, size_t slot)
 {
-	return f(br_peek_read_data(ring), br_get_size(ring, ring->read));
+	uint64_t* word = br_selector_get_word(selector, slot);
+	uint64_t bit = br_selector_get_bit(slot);
+	if(0 == (__atomic_load_n(word, __ATOMIC_RELAXED) & bit)) { __atomic_fetch_or(word, bit, __ATOMIC_RELAXED); }
 }
 
-bool br_push(byte_ring_t* ring, uint8_t byte)
+// the bit goes down before the consumer looks at the ring, so a line published after the look raises it again
+inline static void br_selector_lower(br_selector_t* selector, size_t slot)
 {
-	return (ring->push_function(ring, byte));
+	__atomic_fetch_and(br_selector_get_word(selector, slot), ~br_selector_get_bit(slot), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
 }
 
-//bool br_cinch(byte_ring_t* ring, uint8_t byte)
-//{
-//	size_t size = br_get_size(ring, ring->write);
-//	//size_t index = br_get_size_map_index(ring, ring->write);
-//	
-//	if((ring->line_length - size - sizeof(byte) > ring->line_length)
-//		|| (ring->line_length - size - sizeof(byte) < 0))
-//	{
-//		goto function_exit;
-//	}
-//	
-//	// block overwrite with byte for however many is left, without the last one
-//	memset(ring->write + size, (int) byte, (ring->line_length - size - sizeof(byte)) * sizeof(byte));
-//	
-//	// don't adjust the counter, since this is dummy data
-//	// leave a space for the final push
-//	//br_set_size(ring, index, ring->line_length - 1);
-//	
-//	// then try to increment head according to behavior with the final byte being pushed
-//function_exit:
-//	return ring->push_function(ring, byte);
-//}
-//
-//bool br_cinch00(byte_ring_t* ring)
-//{
-//	return br_cinch(ring, 0x00);
-//}
-//
-//bool br_cinchFF(byte_ring_t* ring)
-//{
-//	return br_cinch(ring, 0xFF);
-//}
+// a ring that has lines is handed out with one of them as its read line, so br_pop finds it right away
+// the read line may have been consumed already, then the next line is there, see br_pop_wait
+inline static byte_ring_t* br_selector_hand_out(byte_ring_t* ring)
+{
+	if(0 == br_peek_read_size(ring)) { br_seek(ring); }
+	return (ring);
+}
 
-bool br_advance_write_head(byte_ring_t* ring)
+// the first slot from slot on with its bit up, wrapping around, number_slots when there is none
+static size_t br_selector_find_ready(br_selector_t* selector, size_t slot)
 {
-	bool clobber			= br_write_will_point_to_read(ring);
-	bool full				= br_write_line_is_full(ring);
-	bool overwrite			= clobber && full;
-	bool function_value		= false;
-	
-	if(false == overwrite)
-	{
-		br_move_write_line_forward(ring);
-		function_value = true;
-	}
-		
-	if(true == overwrite)
+	size_t function_value = selector->number_slots;
+	size_t word = slot / BR_SELECTOR_WORD_BITS;
+	uint64_t mask = ~((uint64_t) 0) << (slot % BR_SELECTOR_WORD_BITS);
+
+	// the first word is looked at again last, for the slots in front of slot
+	for(size_t i = 0; i <= selector->number_words; i++)
 	{
-		switch(_br_get_flags(ring) & BR_BEHAVIOR_FLAGS_MASK)
+		uint64_t bits = __atomic_load_n(&(selector->ready[word]), __ATOMIC_RELAXED) & mask;
+		if(0 != bits)
 		{
-				case BR_OVERWRITE_OLDEST:
-					{
-						br_move_read_line_forward(ring);
-						br_move_write_line_forward(ring);
-						_br_add_flags(ring, BR_FLAG_OVERWRITE);
-						function_value = true;
-					}
-				break;
-				
-				case BR_OVERWRITE_NEWEST:
-					{
-						br_reset_write_head(ring);
-						_br_add_flags(ring, BR_FLAG_OVERWRITE);
-						function_value = true;
-					}
-				break;
-				
-				case BR_OVERWRITE_REFUSAL:
-					{
-						function_value = false;
-					}
-				break;
+			function_value = (word * BR_SELECTOR_WORD_BITS) + (size_t) __builtin_ctzll((unsigned long long) bits);
+			goto function_exit;
 		}
-	}	
-	
-	_br_add_flags(ring, BR_FLAG_DATA_READY);
+
+		mask = ~((uint64_t) 0);
+		word = ((word + 1) == selector->number_words) ? 0 : (word + 1);
+	}
+
+function_exit:
 	return (function_value);
 }
 
-bool br_seek(byte_ring_t* ring)
+br_selector_t* br_selector_create(size_t n_rings)
 {
-	bool function_value = false;
-	br_reset_read_head(ring);
-	bool clobber = br_read_will_point_to_write(ring);
-	
-	if(false == clobber)
+	br_selector_t* selector		= NULL;
+	if((0 == n_rings) || (UINT32_MAX <= n_rings)) { goto fail_early; }
+
+	selector									= (br_selector_t*) aligned_alloc(BR_CACHE_LINE_SIZE, sizeof(br_selector_t));
+	if(NULL == selector) { goto fail_early; }
+
+	// the bitmap gets cache lines of its own, the producers write it
+	size_t words_size					= ((n_rings + BR_SELECTOR_WORD_BITS - 1) / BR_SELECTOR_WORD_BITS) * sizeof(uint64_t);
+	words_size								= (words_size + BR_CACHE_LINE_SIZE - 1) / BR_CACHE_LINE_SIZE * BR_CACHE_LINE_SIZE;
+
+	selector->number_slots		= n_rings;
+	selector->number_words		= (n_rings + BR_SELECTOR_WORD_BITS - 1) / BR_SELECTOR_WORD_BITS;
+	selector->current					= 0;
+	selector->credit					= 0;
+	selector->ready						= (uint64_t*) aligned_alloc(BR_CACHE_LINE_SIZE, words_size);
+	selector->rings						= (byte_ring_t**) calloc(n_rings, sizeof(byte_ring_t*));
+	selector->weights					= (uint32_t*) calloc(n_rings, sizeof(uint32_t));
+	if((NULL == selector->ready) || (NULL == selector->rings) || (NULL == selector->weights)) { goto fail_late; }
+
+	memset(selector->ready, 0, words_size);
+
+	goto fail_early;
+fail_late:
+	free(selector->ready);
+	free(selector->rings);
+	free(selector->weights);
+	free(selector);
+	selector = NULL;
+fail_early:
+	return selector;
+}
+
+void br_selector_destroy(br_selector_t** selector)
+{
+	for(size_t slot = 0; slot < (*selector)->number_slots; slot++)
 	{
-		br_move_read_line_forward(ring);
-		function_value = true;
+		byte_ring_t* ring = (*selector)->rings[slot];
+		if(NULL != ring) { __atomic_store_n(&(ring->selector), NULL, __ATOMIC_RELEASE); }
 	}
-	
-	return (function_value);
+
+	free((*selector)->ready);
+	free((*selector)->rings);
+	free((*selector)->weights);
+	free(*selector);
+	*selector = NULL;
 }
 
-void br_clear(byte_ring_t* ring)
+bool br_selector_add(br_selector_t* selector, byte_ring_t* ring, uint32_t weight)
 {
-	size_t size = br_get_backing_store_size(ring);
-	uint8_t* backing_store = br_get_first_line(ring);
-	memset(backing_store, 0, size * sizeof(uint8_t));
-	memset(ring->size_map, 0, sizeof(size_t) * (ring->number_lines));
+	bool function_value = false;
+	size_t slot = 0;
 
-	ring->read	= br_get_final_line(ring);
-	ring->write	= br_get_first_line(ring);
-	br_reset_read_head(ring);
-	br_reset_write_head(ring);
+	// a producer in another process could not reach the selector
+	if((0 == weight) || (true == br_is_shareable(ring))) { goto function_exit; }
+	if(NULL != __atomic_load_n(&(ring->selector), __ATOMIC_RELAXED)) { goto function_exit; }
 
-	_br_clear_event_flags(ring);
-	br_check_truths(ring);
-}
+	while((slot < selector->number_slots) && (NULL != selector->rings[slot])) { slot++; }
+	if(selector->number_slots == slot) { goto function_exit; }
 
-void br_set_flag(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
-{
-	uint32_t new_flags = _br_get_flags(ring) | (event_flag & BR_EVENT_FLAGS_MASK);
-	_br_add_flags(ring, new_flags);
-}
+	selector->rings[slot]			= ring;
+	selector->weights[slot]		= weight;
+	__atomic_store_n(&(ring->selector_slot), slot, __ATOMIC_RELAXED);
+	__atomic_store_n(&(ring->selector), selector, __ATOMIC_RELEASE);
 
-void br_clear_flag(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
-{
-	_br_clear_flag(ring, event_flag & BR_EVENT_FLAGS_MASK);
+	// the lines published before the ring joined get a turn as well
+	br_selector_raise(selector, slot);
+	function_value = true;
+
+function_exit:
+	return (function_value);
 }
 
-bool br_flag_is_set(byte_ring_t* ring, BR_EVENT_FLAGS event_flag)
+bool br_selector_remove(br_selector_t* selector, byte_ring_t* ring)
 {
-	uint32_t flags = _br_get_flags(ring);
-	return (0 != (event_flag & flags));
+	bool function_value = (selector == __atomic_load_n(&(ring->selector), __ATOMIC_RELAXED));
+	if(false == function_value) { goto function_exit; }
+
+	// the producer is not publishing, see byte_ring.h, so nothing loaded the selector before this and raises its bit after
+	size_t slot = ring->selector_slot;
+	__atomic_store_n(&(ring->selector), NULL, __ATOMIC_RELEASE);
+	selector->rings[slot] = NULL;
+	br_selector_lower(selector, slot);
+	if(selector->current == slot) { selector->credit = 0; }
+
+function_exit:
+	return (function_value);
 }
 
-ssize_t br_pop(byte_ring_t* ring, uint8_t* dst, br_ready_for_pop f)
+byte_ring_t* br_selector_next(br_selector_t* selector)
 {
-	size_t size = br_get_size(ring, ring->read);
-	ssize_t function_value = 0;
-	int action = f(br_peek_read_data(ring), size);
-	
-	if(BR_NOT_READY == action)
-	{
-		goto function_exit;
-	}
+	byte_ring_t* function_value = NULL;
+	size_t slot = selector->current;
+	byte_ring_t* ring = selector->rings[slot];
 
-	if(BR_TRUNCATE == action)
+	// the ring whose turn it is keeps it while it has lines and weight left
+	// its bit went down when the turn began, so a ring that still has lines is raised for the next round
+	if((NULL != ring) && (false == br_is_empty(ring)))
 	{
-		br_seek(ring);
-		function_value = -1;
-		goto function_exit;
+		if(0 != selector->credit)
+		{
+			selector->credit -= 1;
+			function_value = br_selector_hand_out(ring);
+			goto function_exit;
+		}
+
+		br_selector_raise(selector, slot);
 	}
 
-	if(BR_READY == action)
+	selector->credit = 0;
+
+	// every slot is tried at most once, a producer that keeps raising bits cannot hold the consumer here
+	for(size_t tries = 0; tries < selector->number_slots; tries++)
 	{
-		memcpy(dst, ring->read, size);
-		function_value = size;
-		br_seek(ring);
-		goto function_exit;
+		slot = br_selector_find_ready(selector, (slot + 1) % selector->number_slots);
+		if(selector->number_slots == slot) { goto function_exit; }
+
+		// a bit can outlive its lines, when they were popped during an earlier turn of the ring
+		br_selector_lower(selector, slot);
+		ring = selector->rings[slot];
+		if((NULL != ring) && (false == br_is_empty(ring)))
+		{
+			selector->current = slot;
+			selector->credit = selector->weights[slot] - 1;
+			function_value = br_selector_hand_out(ring);
+			goto function_exit;
+		}
 	}
 
 function_exit:
-	return function_value;
+	return (function_value);
+}
+
+byte_ring_t* br_selector_pop_batch(br_selector_t* selector, br_span_t* spans, size_t max, br_ready_for_pop f, size_t* n)
+{
+	*n = 0;
+	byte_ring_t* function_value = br_selector_next(selector);
+	if((NULL == function_value) || (0 == max)) { goto function_exit; }
+
+	// br_selector_next already took one of the turn's lines
+	size_t allowed = (size_t) selector->credit + 1;
+	if(max < allowed) { allowed = max; }
+	*n = br_pop_batch(function_value, spans, allowed, f);
+
+	// a ring f is not ready for gives up the rest of its turn
+	selector->credit = (0 == *n) ? 0 : (uint32_t) ((size_t) selector->credit + 1 - *n);
+
+function_exit:
+	return (function_value);
 }
@@ -9,6 +9,8 @@
 //#define BR_STDIO_DEBUG
 //#define BR_ASSERT_ACTIVE
 //#define BR_SHRED_OLD_DATA
+//#define BR_STATS
+//#define BR_TRACE
 
 // this data structure is a ring buffer, that is organized into 'lines'
 //			a line is a byte array, but easier to type
@@ -28,6 +30,8 @@
 // this helps the programmer ensure that a line is valid at any time
 
 typedef struct byte_ring byte_ring_t;
+typedef struct br_pool br_pool_t;
+typedef struct br_selector br_selector_t;
 
 // this enum states what a br_ready_for_pop function should return
 // where BR_TRUNCATE means delete the current line
@@ -43,6 +47,28 @@ typedef enum
 // return 1 for yes this thing can be popped, 0, for no, -1 for overwrite
 typedef int (*br_ready_for_pop)(const uint8_t*, size_t);
 
+// built in br_ready_for_pop functions, br_pop and the others call these directly when handed one
+// every one of them leaves an empty line alone with BR_NOT_READY
+// a line holding a '\n' or a '\0' anywhere is ready, otherwise it is not ready yet
+int br_ready_newline(const uint8_t* data, size_t size);
+int br_ready_nul(const uint8_t* data, size_t size);
+// a line starting with a 4 byte little endian length is ready once it holds that many bytes after the length
+//		not ready while it holds fewer, truncated when it holds more
+int br_ready_length_prefixed(const uint8_t* data, size_t size);
+// a line ending in the 4 byte little endian crc32c of the rest of it is ready, any other line is truncated
+//		uses the sse4.2 crc32 instruction when the cpu has it
+int br_ready_crc32c(const uint8_t* data, size_t size);
+// a line of printable ascii, tabs, '\r' and '\n' is ready, any other line is truncated
+int br_ready_printable(const uint8_t* data, size_t size);
+
+// a borrowed view of a line in the ring, nothing is copied
+// the view is only valid until the line is released back to the ring
+typedef struct br_span
+{
+	const uint8_t*	data;
+	size_t					size;
+} br_span_t;
+
 // the behavior for a ring to follow when the buffer is full
 // BR_OVERWRITE_OLDEST will only overwrite the oldest line
 // BR_OVERWRITE_NEWEST will only overwrite the last received line
@@ -53,9 +79,71 @@ typedef enum
 	BR_OVERWRITE_OLDEST		= (1 << 0),
 	BR_OVERWRITE_NEWEST		= (1 << 1),
 	BR_OVERWRITE_REFUSAL	= (1 << 2),
+
+	// concurrency flags, or'd with one of the behaviors above
+	// BR_CONCURRENT_SPSC allows one producer thread (push, advance) and one consumer thread (seek, pop) to share
+	//		the ring without a lock, br_seek & br_pop stay wait-free
+	//		only BR_OVERWRITE_NEWEST and BR_OVERWRITE_REFUSAL can be used, the create functions fail otherwise
+	//		br_clear and the br_create/br_destroy functions still need both sides to be stopped
+	BR_CONCURRENT_SPSC		= (1 << 11),
+
+	// BR_CONCURRENT_MPSC allows any number of producer threads to share the ring with one consumer thread
+	//		a producer claims a whole line with br_claim_line, fills it alone, and hands it over with br_commit_line
+	//		the consumer only sees committed lines, in the order they were claimed
+	//		only BR_OVERWRITE_REFUSAL can be used, br_push, br_push_bytes, br_write_reserve and
+	//		br_advance_write_head always refuse
+	BR_CONCURRENT_MPSC		= (1 << 12),
+
+	// storage flags, or'd with the flags above
+	// BR_MIRRORED_STORE maps the backing store twice back to back (linux only, memfd_create and mmap)
+	//		so data running past the end of the backing store can be read or written as if it continued at its start
+	//		a line that wrapped with BR_FLAG_LINE_WRAPPED can then be copied out of the ring in one go
+	//		and br_create_packed_alloc never has to skip the end of the store
+	//		only the create functions that allocate the backing store take it, and the store has to be a whole number
+	//		of pages, br_create_packed_alloc rounds store_size up to one
+	BR_MIRRORED_STORE			= (1 << 13),
+
+	// BR_WAITABLE lets the consumer sleep in br_pop_wait, or on br_get_notify_fd, until a line is published (linux only)
+	//		every line published then costs the producer a fence and a look at whether the consumer sleeps
+	//		and a wakeup only when it does
+	BR_WAITABLE						= (1 << 14),
+
+	// BR_BATCHED_PUBLISH holds finished lines back from the consumer and publishes them together
+	//		a batch goes out once it has BR_PUBLISH_BATCH_LINES lines, when the ring fills up, or on br_flush
+	//		see br_set_publish_batch, not with BR_CONCURRENT_MPSC
+	BR_BATCHED_PUBLISH		= (1 << 15),
 }
 BR_BEHAVIOR_FLAGS;
 
+// the kind of pages a backing store is put on, see br_alloc_options_t
+// BR_PAGES_TRANSPARENT_HUGE asks for transparent huge pages with madvise, and the ring works either way
+// BR_PAGES_HUGETLB maps reserved huge pages, the create functions fail when none are left
+typedef enum
+{
+	BR_PAGES_DEFAULT			= 0,
+	BR_PAGES_TRANSPARENT_HUGE,
+	BR_PAGES_HUGETLB,
+}
+BR_PAGE_KIND;
+
+// how the _with create functions allocate the backing store, a zeroed struct gives the same store as the others
+// anything but the alignment makes the ring map the store instead of taking it from the heap (linux only)
+//		alignment		the store's alignment, 0 for malloc's own, a mapped store fails on anything past its page size
+//		pages				see BR_PAGE_KIND, huge pages cannot be used with BR_MIRRORED_STORE
+//		numa_bind		binds the store to numa_node before any of it is faulted in
+//		prefault		faults a mapped store in during creation, instead of during the first pass through the ring
+//								a mapped store is zeroed by the kernel and left alone otherwise, a store from the heap is zeroed,
+//								and so faulted in, during creation either way
+typedef struct br_alloc_options
+{
+	size_t					alignment;
+	BR_PAGE_KIND		pages;
+	bool						numa_bind;
+	unsigned				numa_node;
+	bool						prefault;
+}
+br_alloc_options_t;
+
 // the event flags are only set by the ring and never checked, they are not cleared by the ring either
 // they can be set externally if so chosen, and they can be checked at any time
 // LINE_WRAPPED and OVERWRITE have similar conditions, but the ring will only set 1 of those at a time
@@ -76,24 +164,178 @@ typedef enum
 	
 	// br_advance_write_head was called on the ring at some point
 	BR_FLAG_DATA_READY		=		(1 << 7),
+
+	// br_open_mapped found a file its last owner did not close, and the write line holds data that may be part of a record
+	//		with BR_CONCURRENT_MPSC, also that a claimed line was never committed and is now empty
+	BR_FLAG_TORN_LINE			=		(1 << 21),
 }
 BR_EVENT_FLAGS;
 
+// how many buckets br_stats_t splits the line length into
+#ifndef BR_STATS_FILL_BUCKETS
+#define BR_STATS_FILL_BUCKETS			8
+#endif
+
+// what happened to a ring since it was created, only counted when the library is built with BR_STATS
+//		the flags above say that something happened, these say how often
+typedef struct br_stats
+{
+	uint64_t								bytes_pushed;
+	uint64_t								lines_pushed;
+	uint64_t								lines_popped;
+
+	// lines dropped to make room with BR_OVERWRITE_OLDEST, and write lines thrown away with BR_OVERWRITE_NEWEST
+	uint64_t								overwrites_oldest;
+	uint64_t								overwrites_newest;
+
+	// writes and head advances that BR_OVERWRITE_REFUSAL turned away, and lines that a ready function truncated
+	uint64_t								refusals;
+	uint64_t								truncations;
+
+	// the most lines seen waiting at once, looked at whenever either side reloads the other's head
+	uint64_t								high_water_lines;
+
+	// lines by how full they were when they were published, bucket i holds the sizes from
+	//		i * (line length + 1) / BR_STATS_FILL_BUCKETS on, an empty line lands in bucket 0 and a full one in the last
+	uint64_t								fill_histogram[BR_STATS_FILL_BUCKETS];
+} br_stats_t;
+
+// the tracepoints a ring passes, only built in with BR_TRACE, see br_set_trace_hook
+typedef enum
+{
+	// the write head moved past a line, or a line was committed with BR_CONCURRENT_MPSC, size is what the line holds
+	BR_TRACE_LINE_ADVANCE	= 0,
+
+	// a line was thrown away to make room, the oldest one with BR_OVERWRITE_OLDEST and the write line with
+	//		BR_OVERWRITE_NEWEST, size is what it held
+	BR_TRACE_OVERWRITE		= 1,
+
+	// BR_OVERWRITE_REFUSAL turned a write or a head advance away, line is the write line or the line that could not be claimed
+	BR_TRACE_REFUSAL			= 2,
+
+	// a ready function truncated the read line
+	BR_TRACE_TRUNCATE			= 3,
+
+	// br_clear or br_clear_secure emptied the ring, line is the write line and size the bytes that were dropped
+	BR_TRACE_CLEAR				= 4,
+}
+BR_TRACE_EVENT;
+
+// ring is the ring that passed the tracepoint, line the index of the line in it (below the number of lines)
+//		and size a size in bytes, see BR_TRACE_EVENT
+typedef void (*br_trace_hook)(BR_TRACE_EVENT event, const byte_ring_t* ring, size_t line, size_t size);
+
 // === housekeeping ===
 // returns a dynamically allocated ring
 //		with dynamically allocated memory for the backing store
 byte_ring_t* br_create_full_alloc(size_t n_lines, size_t len_lines,
 		BR_BEHAVIOR_FLAGS behavior_flag);
 
+// same as br_create_full_alloc, with the backing store allocated wrt options
+byte_ring_t* br_create_full_alloc_with(size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag, const br_alloc_options_t* options);
+
 // returns a dynamically allocated ring
 //		that uses a given backing store buffer
 byte_ring_t* br_create_alloc_static_backing_store(size_t n_lines, size_t len_lines,
 		BR_BEHAVIOR_FLAGS behavior_flag, uint8_t* backing_store);
 
+// returns a dynamically allocated ring that packs its lines back to back in a store_size byte backing store
+//		instead of giving every line len_lines bytes, len_lines is only the longest a line can be
+//		n_lines still bounds how many lines the ring holds, and the ring is also full when the store is
+//		store_size has to be at least 5 * len_lines, and BR_CONCURRENT_MPSC cannot be used
+byte_ring_t* br_create_packed_alloc(size_t n_lines, size_t len_lines, size_t store_size,
+		BR_BEHAVIOR_FLAGS behavior_flag);
+
+// same as br_create_packed_alloc, with the backing store allocated wrt options
+byte_ring_t* br_create_packed_alloc_with(size_t n_lines, size_t len_lines, size_t store_size,
+		BR_BEHAVIOR_FLAGS behavior_flag, const br_alloc_options_t* options);
+
 // returns a ring s.t. one internal feature is allocated, the rest is not
 int br_alloc_full_static(byte_ring_t* ring, size_t n_lines, size_t len_lines,
 	BR_BEHAVIOR_FLAGS behavior_flag, uint8_t* backing_store);
 
+// the number of bytes br_create_in_place needs for a ring with this geometry
+size_t br_required_size(size_t n_lines, size_t len_lines);
+
+// builds a ring inside buffer without allocating anything, the struct, size map and backing store all live in it
+//		buffer has to be aligned to BR_CACHE_LINE_SIZE (64 unless overridden) and at least br_required_size bytes
+//		br_destroy releases nothing, the buffer stays the caller's
+//		BR_MIRRORED_STORE cannot be used
+byte_ring_t* br_create_in_place(void* buffer, size_t buffer_size, size_t n_lines, size_t len_lines,
+	BR_BEHAVIOR_FLAGS behavior_flag);
+
+// returns the ring br_create_in_place built in buffer, as it is seen at this address, NULL when buffer holds no usable ring
+//		the ring keeps no pointers, so a block shared through shm_open or memfd_create with MAP_SHARED can be mapped
+//		anywhere in another process and attached there, one process as the producer and one as the consumer
+//		only the layout and heads are checked, both processes need builds with the same struct layout and BR_CACHE_LINE_SIZE
+//		a consumer in another process waits with br_pop_wait, the notification fd only wakes the process that opened it
+//		br_destroy of an attached ring releases nothing
+byte_ring_t* br_attach(void* buffer, size_t buffer_size);
+
+// same as br_create_in_place, in one dynamically allocated block that br_destroy frees
+byte_ring_t* br_create_single_alloc(size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag);
+
+// returns a ring that lives in a file at path, created or truncated to fit, see br_create_in_place for what is supported
+//		the geometry, flags, heads, size map and backing store are all in the file, nothing is kept elsewhere
+//		the file is only good for builds with the same struct layout and BR_CACHE_LINE_SIZE, linux only
+#ifdef __linux__
+byte_ring_t* br_create_mapped(const char* path, size_t n_lines, size_t len_lines,
+		BR_BEHAVIOR_FLAGS behavior_flag);
+
+// maps a file made by br_create_mapped back in place, without copying anything
+//		returns NULL when the file is not a ring file, has another version, or its heads and sizes make no sense
+//		a file whose last owner did not get to br_destroy raises BR_FLAG_TORN_LINE when something was left half written
+//		br_destroy writes the file back and marks it closed
+byte_ring_t* br_open_mapped(const char* path);
+
+// writes a mapped ring back to its file, the lines written before this survive a crash of the machine as well
+//		returns false when the ring is not mapped or msync fails
+bool br_sync_mapped(byte_ring_t* ring);
+#endif
+
+// === pool ===
+// returns a dynamically allocated pool of n_rings rings that all share one geometry and behavior, built in one arena
+//		rings are handed out and back in O(1) without a lock, from any number of threads
+//		a ring put back is emptied with br_clear
+br_pool_t* br_pool_create(size_t n_rings, size_t n_lines, size_t len_lines, BR_BEHAVIOR_FLAGS behavior_flag);
+// frees the pool and every ring in it, whether or not it was put back
+void br_pool_destroy(br_pool_t** pool);
+// takes an empty ring from the pool, returns NULL when every ring is taken
+byte_ring_t* br_pool_get(br_pool_t* pool);
+// hands a ring from br_pool_get back to the pool, rings from a pool are never given to br_destroy
+void br_pool_put(br_pool_t* pool, byte_ring_t* ring);
+
+// === selector ===
+// one consumer serving many rings asks a selector for the next ring with lines, instead of looking at every ring
+//		the producer of a ring in a selector raises the ring's bit whenever it publishes lines, with br_advance_write_head,
+//		a full line moving on, br_flush or br_commit_line, so the consumer's cost grows with the busy rings, not all of them
+//		only the consumer calls these, producers push the way they would without a selector
+// returns a dynamically allocated selector with room for n_rings rings
+br_selector_t* br_selector_create(size_t n_rings);
+// frees the selector, the rings still in it are taken out first, and none of their producers may be publishing
+void br_selector_destroy(br_selector_t** selector);
+// puts the ring in the selector, where it gets up to weight lines in a row each round, see br_selector_next
+//		returns false when the selector is full, weight is 0, or the ring is in a selector already
+//		a ring other processes can see is refused, one from br_create_in_place, br_attach or a mapped file
+//		a ring from br_create_single_alloc or a pool is fine, and it is taken out before br_destroy or br_pool_put
+bool br_selector_add(br_selector_t* selector, byte_ring_t* ring, uint32_t weight);
+// takes the ring out of the selector, returns false when it was not in it
+//		the ring's producer may not be publishing meanwhile, the same as for br_selector_destroy
+//		one that had already loaded the selector would raise the ring's bit after it went down, and could still be
+//		touching the selector once it has been destroyed
+bool br_selector_remove(br_selector_t* selector, byte_ring_t* ring);
+// returns a ring in the selector with lines to pop, seeked to the first of them when its read line was used up
+//		NULL when no ring has any
+//		the rings with lines take turns in the order of their slots, and the ring whose turn it is comes back
+//		up to its weight times in a row, popping about a line per call, before the next one gets its turn
+byte_ring_t* br_selector_next(br_selector_t* selector);
+// br_selector_next, then br_pop_batch on that ring for up to max lines, never more than are left of its turn
+//		returns the ring and sets n to the spans filled, which go back with br_read_release_lines before the next call
+//		returns NULL and sets n to 0 when no ring has lines, and a ring that f is not ready for ends its turn with none
+byte_ring_t* br_selector_pop_batch(br_selector_t* selector, br_span_t* spans, size_t max, br_ready_for_pop f, size_t* n);
+
 // frees any memory that was allocated to a ring
 void br_destroy_internals(byte_ring_t* br);
 // frees all memory for a full alloc ring
@@ -117,16 +359,65 @@ size_t br_peek_write_size(byte_ring_t* ring);
 const uint8_t* br_peek_write_data(byte_ring_t* ring);
 // gives f access (like br_peek) but with the stored length as well
 int br_is_ready(byte_ring_t* ring, br_ready_for_pop f);
+// fills span with the memory every line of the ring lies in, both mappings of it with BR_MIRRORED_STORE
+//		meant for registering the backing store with the kernel, see byte_ring_uring.h
+void br_get_backing_store(byte_ring_t* ring, br_span_t* span);
+// O(1) answers from the heads and two byte counters, right for the moment they are called from either side
+//		br_is_full on a ring from br_create_packed_alloc is the one exception, only its producer can ask
+// the lines br_pop can hand out, the read line included while it holds data
+//		lines held back by BR_BATCHED_PUBLISH are not counted until br_flush, the same as br_is_empty
+//		with BR_CONCURRENT_MPSC, nothing past the read line is counted until the line after it is committed,
+//		then every line claimed after it is, committed or not
+size_t br_lines_used(byte_ring_t* ring);
+// how many more times the write head can move before the ring is full
+//		lines written but not handed out yet take up room, so this and br_lines_used can add up to less than the ring
+//		a ring from br_create_packed_alloc can also run out of bytes first, br_is_full tells when it has
+size_t br_lines_free(byte_ring_t* ring);
+// the bytes in every line that has not been released yet, the write line included
+size_t br_bytes_used(byte_ring_t* ring);
+// true when br_pop has nothing to hand out
+bool br_is_empty(byte_ring_t* ring);
+// true when the producer would have to overwrite or refuse to move the write head, see br_advance_write_head
+//		only from the producer on a ring from br_create_packed_alloc, it needs where the write line ends
+bool br_is_full(byte_ring_t* ring);
+// copies the counters into out, each side keeps its own, so they can be a few events apart while the ring is in use
+//		returns false and zeroes out when the library is built without BR_STATS
+bool br_get_stats(byte_ring_t* ring, br_stats_t* out);
 
 // === mutators ===
 // write a new byte wrt behavior
 bool br_push(byte_ring_t* ring, uint8_t byte);
+// write up to n bytes wrt behavior, copying a line at a time
+//		returns the number of bytes accepted, which is only short of n when the behavior refuses
+size_t br_push_bytes(byte_ring_t* ring, const uint8_t* src, size_t n);
+// same as br_push and br_push_bytes for a ring created with that one behavior, without deciding on the behavior per call
+//		a ring created with any other behavior, or with BR_CONCURRENT_MPSC, is left alone and false or 0 is returned
+bool br_push_oldest(byte_ring_t* ring, uint8_t byte);
+bool br_push_newest(byte_ring_t* ring, uint8_t byte);
+bool br_push_refuse(byte_ring_t* ring, uint8_t byte);
+size_t br_push_bytes_oldest(byte_ring_t* ring, const uint8_t* src, size_t n);
+size_t br_push_bytes_newest(byte_ring_t* ring, const uint8_t* src, size_t n);
+size_t br_push_bytes_refuse(byte_ring_t* ring, const uint8_t* src, size_t n);
+// same as br_push_bytes, except the write head is advanced after every delimiter, which is kept at the end of its line
+//		a frame longer than a line wraps onto the next one like br_push_bytes would
+//		stops early when the behavior refuses, a frame that was written but could not be advanced stays on the write line
+size_t br_push_framed(byte_ring_t* ring, const uint8_t* src, size_t n, uint8_t delimiter);
 // seek next line wrt behavior
 bool br_seek(byte_ring_t* ring);
-// invalidate all data in this ring
+// invalidate all data in this ring in O(1), the data stays in the backing store until it is overwritten
+//		unless BR_SHRED_OLD_DATA is defined, then this is br_clear_secure
 void br_clear(byte_ring_t* br);
+// invalidate all data in this ring and wipe the whole backing store
+void br_clear_secure(byte_ring_t* br);
 // manually request to move the write head forward, returns true if it succeeded, false if it did not (overwriting when behavior says not to overwrite)
 bool br_advance_write_head(byte_ring_t* ring);
+// publishes the lines a BR_BATCHED_PUBLISH ring is holding back, returns false when there were none or the ring does not batch
+//		a producer that goes quiet has to call this, otherwise its last lines wait for the next batch
+bool br_flush(byte_ring_t* ring);
+// a BR_BATCHED_PUBLISH ring publishes once it holds lines, or once the first line it holds is max_delay_ns old
+//		the delay is only checked when a line is written, 0 turns it off, and costs a clock read per line otherwise
+//		called by the producer, returns false when lines is 0 or the ring does not batch
+bool br_set_publish_batch(byte_ring_t* ring, size_t lines, uint64_t max_delay_ns);
 
 // sets an individual flag (bitwise) on the ring
 void br_set_flag(byte_ring_t* ring, BR_EVENT_FLAGS event_flag);
@@ -140,4 +431,76 @@ bool br_flag_is_set(byte_ring_t* ring, BR_EVENT_FLAGS event_flag);
 // f returns BR_READY				=> br_seek and returns number of bytes copied to dst
 ssize_t br_pop(byte_ring_t* ring, uint8_t* dst, br_ready_for_pop f);
 
+// === zero copy ===
+// fills span with the current read line, returns true if the line holds data
+//		the line belongs to the caller until br_read_release is called
+bool br_read_acquire(byte_ring_t* ring, br_span_t* span);
+// hands a line taken by br_read_acquire or br_pop_view back to the ring, then seeks like br_seek
+bool br_read_release(byte_ring_t* ring);
+// same contract as br_pop, except BR_READY fills span instead of copying
+//		and the ring does not seek until br_read_release is called
+ssize_t br_pop_view(byte_ring_t* ring, br_span_t* span, br_ready_for_pop f);
+// fills up to max spans with consecutive lines from the read line on, for as long as f returns BR_READY
+//		an empty read line, one already popped or released, is seeked past first, the same as br_drain_to_fd
+//		a line f truncates is dropped when it comes first, otherwise it ends the batch like BR_NOT_READY
+//		returns the number of spans filled, those lines belong to the caller until br_read_release_lines
+size_t br_pop_batch(byte_ring_t* ring, br_span_t* spans, size_t max, br_ready_for_pop f);
+// same as n calls to br_read_release, but the read head is only published once
+//		returns how many lines the read head moved
+size_t br_read_release_lines(byte_ring_t* ring, size_t n);
+// points out at the free space of the write line wrt behavior, returns how many bytes of want fit there
+//		returns 0 and sets out to NULL when the behavior refuses
+size_t br_write_reserve(byte_ring_t* ring, size_t want, uint8_t** out);
+// marks n bytes written through br_write_reserve as part of the write line, returns the bytes kept
+size_t br_write_commit(byte_ring_t* ring, size_t n);
+
+
+// === file descriptors ===
+// reads up to max bytes from fd with one readv, straight into the write line and the free lines after it
+//		the behavior only applies to the write line, like br_push before a byte, lines after it are never overwritten
+//		the bytes are taken like br_push_bytes would take them, every line but the last is advanced past
+//		returns what readv returned, 0 at the end of the file, -1 with errno set on an error
+//		-1 with ENOBUFS when the behavior refuses, or the ring has several producers
+ssize_t br_fill_from_fd(byte_ring_t* ring, int fd, size_t max);
+// writes up to max_lines lines from the read line on to fd with one writev, using the sizes of the lines
+//		the lines that went out whole are released like br_read_release_lines
+//		when a line only went out in part, the rest of it becomes the read line and goes out first next time
+//		returns what writev returned, the ring is not touched on an error
+ssize_t br_drain_to_fd(byte_ring_t* ring, int fd, size_t max_lines);
+
+// === waiting ===
+#ifdef __linux__
+// same as br_pop, except an empty ring is waited on for up to timeout_ms, -1 waits forever and 0 not at all
+//		spins for a while first, then sleeps when the ring is BR_WAITABLE, and polls when it is not
+//		returns 0 when the timeout ran out, and right away when f is not ready for the read line
+//		only one thread may wait on a ring, it is the consumer
+ssize_t br_pop_wait(byte_ring_t* ring, uint8_t* dst, br_ready_for_pop f, int timeout_ms);
+// returns an eventfd for epoll and the like that becomes readable once a line is published after br_arm_notify_fd
+//		the fd is opened by the first call and closed by br_destroy_internals, returns -1 if it cannot be opened
+//		only BR_WAITABLE rings ever signal it, and only producers in the process that called this, see br_attach
+int br_get_notify_fd(byte_ring_t* ring);
+// resets the fd and arms it for the next published line, call it before going to sleep on the fd
+//		returns false when there is a line to read already, or the fd cannot be opened, then the caller should not sleep
+bool br_arm_notify_fd(byte_ring_t* ring);
+#endif
+
+// === tracing ===
+#ifdef BR_TRACE
+// sets the one hook every ring in the process calls at its tracepoints, NULL turns them off again
+//		the hook runs on the thread that passed the tracepoint, in the middle of the ring's work, so it must not touch the ring
+//		without BR_TRACE there are no tracepoints at all, they compile to nothing
+void br_set_trace_hook(br_trace_hook hook);
+#endif
+
+// === multiple producers ===
+// only for BR_CONCURRENT_MPSC rings, the others always refuse
+// claims the next free line for the calling producer alone, returns NULL when the ring is full
+//		the line is line length bytes long, and nothing else writes to it until it is committed
+uint8_t* br_claim_line(byte_ring_t* ring);
+// publishes a line from br_claim_line holding size bytes to the consumer
+void br_commit_line(byte_ring_t* ring, uint8_t* line, size_t size);
+// claims a line, copies up to a line length of src into it and commits it
+//		returns the number of bytes committed, or -1 when no line was free
+ssize_t br_push_line(byte_ring_t* ring, const uint8_t* src, size_t n);
+
 #endif
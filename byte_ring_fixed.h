@@ -0,0 +1,459 @@
+#ifndef __BYTE_RING_FIXED_H__
+#define __BYTE_RING_FIXED_H__
+
+#include "byte_ring.h"
+#include <string.h>
+
+// a byte_ring whose geometry and behavior are fixed at build time
+// BR_DEFINE_RING(name, N_LINES, LINE_LEN, BEHAVIOR) emits a name_t type with a statically sized
+//		backing store and size map, and static inline name_* functions that mirror the byte_ring API
+// every function hands its constants to the _br_fixed_* helpers below, once those are inlined
+//		the compiler sees constant geometry, masks power of two geometries, and drops the other behaviors
+// the heads, the full and empty rules and the event flags work exactly like a byte_ring with the same behavior
+// BEHAVIOR must be one of BR_OVERWRITE_OLDEST, BR_OVERWRITE_NEWEST or BR_OVERWRITE_REFUSAL,
+//		a fixed ring is not meant to be shared between threads
+// name_init zeroes the whole ring once, like the create functions, after that name_clear empties it in O(1)
+// the header stands alone, a program only has to link byte_ring.c for BR_FIXED_DIRECT_READY or the br_ready_* predicates
+//
+// BR_DEFINE_RING(uart_ring, 256, 128, BR_OVERWRITE_OLDEST)
+// static uart_ring_t uart;
+// uart_ring_init(&uart);
+// uart_ring_push(&uart, byte);
+
+#define BR_FIXED_INLINE				static inline __attribute__((always_inline))
+
+// the narrowest size map entry that holds LINE_LEN, there is no committed bit to make room for in a fixed ring
+#define BR_FIXED_SIZE_WIDTH(LINE_LEN)																											\
+	(((LINE_LEN) <= UINT8_MAX) ? sizeof(uint8_t) : ((LINE_LEN) <= UINT16_MAX) ? sizeof(uint16_t)		\
+		: ((LINE_LEN) <= UINT32_MAX) ? sizeof(uint32_t) : sizeof(uint64_t))
+
+typedef struct br_fixed_heads
+{
+	uint64_t								write;
+	uint64_t								read;
+	uint32_t								bit_flags;
+} br_fixed_heads_t;
+
+// the geometry and behavior of one fixed ring, always built from constants
+typedef struct br_fixed_shape
+{
+	size_t									number_lines;
+	size_t									line_length;
+	size_t									size_width;
+	uint32_t								behavior;
+} br_fixed_shape_t;
+
+BR_FIXED_INLINE size_t _br_fixed_slot(br_fixed_shape_t shape, uint64_t head)
+{
+	return ((size_t) (head % shape.number_lines));
+}
+
+BR_FIXED_INLINE uint8_t* _br_fixed_line(br_fixed_shape_t shape, uint8_t* store, uint64_t head)
+{
+	return (store + (_br_fixed_slot(shape, head) * shape.line_length));
+}
+
+// the size map is kept as bytes, entries are copied in and out so any width can be read without aliasing
+// the width is a constant, so the switch folds away and the copy becomes a single load or store
+BR_FIXED_INLINE size_t _br_fixed_get_size(br_fixed_shape_t shape, const uint8_t* size_map, size_t slot)
+{
+	size_t function_value = 0;
+	const uint8_t* entry = size_map + (slot * shape.size_width);
+
+	switch(shape.size_width)
+	{
+		case sizeof(uint8_t):		{ uint8_t size;		memcpy(&size, entry, sizeof(size));	function_value = size; }	break;
+		case sizeof(uint16_t):	{ uint16_t size;	memcpy(&size, entry, sizeof(size));	function_value = size; }	break;
+		case sizeof(uint32_t):	{ uint32_t size;	memcpy(&size, entry, sizeof(size));	function_value = size; }	break;
+		default:								{ uint64_t size;	memcpy(&size, entry, sizeof(size));	function_value = size; }	break;
+	}
+
+	return (function_value);
+}
+
+BR_FIXED_INLINE void _br_fixed_set_size(br_fixed_shape_t shape, uint8_t* size_map, size_t slot, size_t size)
+{
+	uint8_t* entry = size_map + (slot * shape.size_width);
+
+	switch(shape.size_width)
+	{
+		case sizeof(uint8_t):		{ uint8_t value = (uint8_t) size;		memcpy(entry, &value, sizeof(value)); }	break;
+		case sizeof(uint16_t):	{ uint16_t value = (uint16_t) size;	memcpy(entry, &value, sizeof(value)); }	break;
+		case sizeof(uint32_t):	{ uint32_t value = (uint32_t) size;	memcpy(entry, &value, sizeof(value)); }	break;
+		default:								{ uint64_t value = (uint64_t) size;	memcpy(entry, &value, sizeof(value)); }	break;
+	}
+}
+
+BR_FIXED_INLINE size_t _br_fixed_head_size(br_fixed_shape_t shape, const uint8_t* size_map, uint64_t head)
+{
+	return (_br_fixed_get_size(shape, size_map, _br_fixed_slot(shape, head)));
+}
+
+BR_FIXED_INLINE void _br_fixed_reset_head_size(br_fixed_shape_t shape, uint8_t* size_map, uint64_t head)
+{
+	_br_fixed_set_size(shape, size_map, _br_fixed_slot(shape, head), 0);
+}
+
+BR_FIXED_INLINE void _br_fixed_reset_read_line(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+	_br_fixed_reset_head_size(shape, size_map, heads->read);
+
+#	ifdef BR_SHRED_OLD_DATA
+	uint8_t* line = _br_fixed_line(shape, store, heads->read);
+	memset(line, 0xA5, shape.line_length * sizeof(uint8_t));
+	memset(line, 0x5A, shape.line_length * sizeof(uint8_t));
+	memset(line, 0, shape.line_length * sizeof(uint8_t));
+#	endif
+
+	(void) store;
+}
+
+BR_FIXED_INLINE void _br_fixed_move_read_line_forward(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+	_br_fixed_reset_read_line(shape, heads, size_map, store);
+	heads->read += 1;
+}
+
+BR_FIXED_INLINE void _br_fixed_move_write_line_forward(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map)
+{
+	_br_fixed_reset_head_size(shape, size_map, heads->write + 1);
+	heads->write += 1;
+}
+
+BR_FIXED_INLINE bool _br_fixed_write_will_point_to_read(br_fixed_shape_t shape, br_fixed_heads_t* heads)
+{
+	bool clobber = (shape.number_lines - 1 <= heads->write - heads->read);
+	if(true == clobber) { heads->bit_flags |= BR_FLAG_RING_FULL; }
+	return (clobber);
+}
+
+BR_FIXED_INLINE bool _br_fixed_read_will_point_to_write(br_fixed_heads_t* heads)
+{
+	bool clobber = (heads->write - heads->read <= 1);
+	if(true == clobber) { heads->bit_flags |= BR_FLAG_RING_EMPTY; }
+	return (clobber);
+}
+
+BR_FIXED_INLINE bool _br_fixed_write_line_is_full(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map)
+{
+	bool function_value = (shape.line_length <= _br_fixed_head_size(shape, size_map, heads->write));
+	if(true == function_value) { heads->bit_flags |= BR_FLAG_LINE_WRAPPED; }
+	return (function_value);
+}
+
+// the same rules as the br_prepare_* functions, the behavior checks fold away on a constant shape
+BR_FIXED_INLINE bool _br_fixed_prepare_write(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+	bool clobber		= _br_fixed_write_will_point_to_read(shape, heads);
+	bool full				= _br_fixed_write_line_is_full(shape, heads, size_map);
+	bool overwrite	= clobber && full;
+	bool function_value = true;
+
+	if((BR_OVERWRITE_OLDEST == shape.behavior) && (true == overwrite))
+	{
+		_br_fixed_move_read_line_forward(shape, heads, size_map, store);
+		heads->bit_flags |= BR_FLAG_OVERWRITE;
+	}
+
+	if((BR_OVERWRITE_NEWEST == shape.behavior) && (true == overwrite))
+	{
+		_br_fixed_reset_head_size(shape, size_map, heads->write);
+		heads->bit_flags |= BR_FLAG_OVERWRITE;
+	}
+
+	if((BR_OVERWRITE_REFUSAL == shape.behavior) && (true == overwrite))
+	{
+		function_value = false;
+	}
+
+	if((true == full) && ((BR_OVERWRITE_OLDEST == shape.behavior) || (false == overwrite)))
+	{
+		_br_fixed_move_write_line_forward(shape, heads, size_map);
+	}
+
+	return (function_value);
+}
+
+BR_FIXED_INLINE bool _br_fixed_push(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store, uint8_t byte)
+{
+	bool function_value = _br_fixed_prepare_write(shape, heads, size_map, store);
+
+	if(true == function_value)
+	{
+		size_t slot = _br_fixed_slot(shape, heads->write);
+		size_t size = _br_fixed_get_size(shape, size_map, slot);
+		_br_fixed_line(shape, store, heads->write)[size] = byte;
+		_br_fixed_set_size(shape, size_map, slot, size + sizeof(byte));
+	}
+
+	return (function_value);
+}
+
+BR_FIXED_INLINE size_t _br_fixed_push_bytes(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store, const uint8_t* src, size_t n)
+{
+	size_t accepted = 0;
+
+	while(accepted < n)
+	{
+		if(false == _br_fixed_prepare_write(shape, heads, size_map, store)) { break; }
+
+		size_t slot		= _br_fixed_slot(shape, heads->write);
+		size_t size		= _br_fixed_get_size(shape, size_map, slot);
+		size_t chunk	= n - accepted;
+		if(shape.line_length - size < chunk) { chunk = shape.line_length - size; }
+
+		memcpy(_br_fixed_line(shape, store, heads->write) + size, src + accepted, chunk);
+		_br_fixed_set_size(shape, size_map, slot, size + chunk);
+		accepted += chunk;
+
+		// br_push checks for clobber before every byte, checking once per line keeps the event flags identical
+		if(1 < chunk) { _br_fixed_write_will_point_to_read(shape, heads); }
+	}
+
+	return (accepted);
+}
+
+BR_FIXED_INLINE bool _br_fixed_advance_write_head(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+	bool overwrite			= _br_fixed_write_will_point_to_read(shape, heads);
+	bool function_value	= true;
+
+	if(false == overwrite)
+	{
+		_br_fixed_move_write_line_forward(shape, heads, size_map);
+	}
+
+	if((BR_OVERWRITE_OLDEST == shape.behavior) && (true == overwrite))
+	{
+		_br_fixed_move_read_line_forward(shape, heads, size_map, store);
+		_br_fixed_move_write_line_forward(shape, heads, size_map);
+		heads->bit_flags |= BR_FLAG_OVERWRITE;
+	}
+
+	if((BR_OVERWRITE_NEWEST == shape.behavior) && (true == overwrite))
+	{
+		_br_fixed_reset_head_size(shape, size_map, heads->write);
+		heads->bit_flags |= BR_FLAG_OVERWRITE;
+	}
+
+	if((BR_OVERWRITE_REFUSAL == shape.behavior) && (true == overwrite))
+	{
+		function_value = false;
+	}
+
+	heads->bit_flags |= BR_FLAG_DATA_READY;
+	return (function_value);
+}
+
+BR_FIXED_INLINE bool _br_fixed_seek(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+	bool function_value = false;
+	_br_fixed_reset_read_line(shape, heads, size_map, store);
+
+	if(false == _br_fixed_read_will_point_to_write(heads))
+	{
+		_br_fixed_move_read_line_forward(shape, heads, size_map, store);
+		function_value = true;
+	}
+
+	return (function_value);
+}
+
+// calls f, a constant f is inlined once the name_* function it came through is
+// with BR_FIXED_DIRECT_READY defined, the same as br_call_ready, the built in predicates are called by name
+//		they live in byte_ring.c, so it is only for programs that link it, the header needs nothing else
+BR_FIXED_INLINE int _br_fixed_call_ready(br_ready_for_pop f, const uint8_t* data, size_t size)
+{
+	int function_value = 0;
+
+#	ifdef BR_FIXED_DIRECT_READY
+	if(br_ready_newline == f)							{ function_value = br_ready_newline(data, size); }
+	else if(br_ready_nul == f)						{ function_value = br_ready_nul(data, size); }
+	else if(br_ready_length_prefixed == f)	{ function_value = br_ready_length_prefixed(data, size); }
+	else if(br_ready_crc32c == f)					{ function_value = br_ready_crc32c(data, size); }
+	else if(br_ready_printable == f)			{ function_value = br_ready_printable(data, size); }
+	else																	{ function_value = f(data, size); }
+#	else
+	function_value = f(data, size);
+#	endif
+
+	return (function_value);
+}
+
+BR_FIXED_INLINE ssize_t _br_fixed_pop(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store, uint8_t* dst, br_ready_for_pop f)
+{
+	const uint8_t* line = _br_fixed_line(shape, store, heads->read);
+	size_t size = _br_fixed_head_size(shape, size_map, heads->read);
+	ssize_t function_value = 0;
+	int action = _br_fixed_call_ready(f, line, size);
+
+	if(BR_TRUNCATE == action)
+	{
+		_br_fixed_seek(shape, heads, size_map, store);
+		function_value = -1;
+	}
+
+	if(BR_READY == action)
+	{
+		memcpy(dst, line, size);
+		function_value = size;
+		_br_fixed_seek(shape, heads, size_map, store);
+	}
+
+	return (function_value);
+}
+
+// same as br_reset_cursors, only the lines the empty ring starts on are reset
+// every other line has its size reset before it is written, and every line behind the read head when it was passed
+BR_FIXED_INLINE void _br_fixed_reset_cursors(br_fixed_shape_t shape, br_fixed_heads_t* heads, uint8_t* size_map)
+{
+	// the read head starts on the final line and the write head on the first one
+	heads->read				= shape.number_lines - 1;
+	heads->write			= shape.number_lines;
+	heads->bit_flags	= 0;
+
+	_br_fixed_reset_head_size(shape, size_map, heads->read);
+	_br_fixed_reset_head_size(shape, size_map, heads->write);
+}
+
+// zeroes everything and empties the ring, like br_wipe does for the create functions
+BR_FIXED_INLINE void _br_fixed_wipe(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+	memset(store, 0, shape.number_lines * shape.line_length * sizeof(uint8_t));
+	memset(size_map, 0, shape.number_lines * shape.size_width);
+	_br_fixed_reset_cursors(shape, heads, size_map);
+}
+
+// same passes as br_clear_secure
+BR_FIXED_INLINE void _br_fixed_clear_secure(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+	memset(store, 0xA5, shape.number_lines * shape.line_length * sizeof(uint8_t));
+	memset(store, 0x5A, shape.number_lines * shape.line_length * sizeof(uint8_t));
+	_br_fixed_wipe(shape, heads, size_map, store);
+}
+
+// the data stays in the store until it is overwritten, unless BR_SHRED_OLD_DATA makes this _br_fixed_clear_secure
+BR_FIXED_INLINE void _br_fixed_clear(br_fixed_shape_t shape, br_fixed_heads_t* heads,
+	uint8_t* size_map, uint8_t* store)
+{
+#	ifndef BR_SHRED_OLD_DATA
+	_br_fixed_reset_cursors(shape, heads, size_map);
+	(void) store;
+#	endif
+
+#	ifdef BR_SHRED_OLD_DATA
+	_br_fixed_clear_secure(shape, heads, size_map, store);
+#	endif
+}
+
+#define BR_DEFINE_RING(name, N_LINES, LINE_LEN, BEHAVIOR)																	\
+	_Static_assert(1 < (N_LINES) && 0 < (LINE_LEN), #name ": a ring needs two lines of at least one byte");	\
+	_Static_assert((BR_OVERWRITE_OLDEST == (BEHAVIOR)) || (BR_OVERWRITE_NEWEST == (BEHAVIOR))				\
+		|| (BR_OVERWRITE_REFUSAL == (BEHAVIOR)), #name ": BEHAVIOR must be a single overwrite behavior");	\
+																																											\
+	typedef struct name																																	\
+	{																																										\
+		br_fixed_heads_t				heads;																										\
+		uint8_t									size_map[(N_LINES) * BR_FIXED_SIZE_WIDTH(LINE_LEN)];			\
+		uint8_t									backing_store[(N_LINES) * (LINE_LEN)];										\
+	} name##_t;																																					\
+																																											\
+	BR_FIXED_INLINE br_fixed_shape_t name##_shape(void)																	\
+	{																																										\
+		br_fixed_shape_t shape = { (N_LINES), (LINE_LEN), BR_FIXED_SIZE_WIDTH(LINE_LEN), (BEHAVIOR) };	\
+		return (shape);																																		\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE void name##_init(name##_t* ring)																		\
+	{																																										\
+		_br_fixed_wipe(name##_shape(), &(ring->heads), ring->size_map, ring->backing_store);		\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE void name##_clear(name##_t* ring)																		\
+	{																																										\
+		_br_fixed_clear(name##_shape(), &(ring->heads), ring->size_map, ring->backing_store);		\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE void name##_clear_secure(name##_t* ring)															\
+	{																																										\
+		_br_fixed_clear_secure(name##_shape(), &(ring->heads), ring->size_map, ring->backing_store);	\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE bool name##_push(name##_t* ring, uint8_t byte)													\
+	{																																										\
+		return (_br_fixed_push(name##_shape(), &(ring->heads), ring->size_map,								\
+			ring->backing_store, byte));																										\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE size_t name##_push_bytes(name##_t* ring, const uint8_t* src, size_t n)	\
+	{																																										\
+		return (_br_fixed_push_bytes(name##_shape(), &(ring->heads), ring->size_map,					\
+			ring->backing_store, src, n));																									\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE bool name##_advance_write_head(name##_t* ring)											\
+	{																																										\
+		return (_br_fixed_advance_write_head(name##_shape(), &(ring->heads), ring->size_map,	\
+			ring->backing_store));																													\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE bool name##_seek(name##_t* ring)																		\
+	{																																										\
+		return (_br_fixed_seek(name##_shape(), &(ring->heads), ring->size_map,								\
+			ring->backing_store));																													\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE ssize_t name##_pop(name##_t* ring, uint8_t* dst, br_ready_for_pop f)		\
+	{																																										\
+		return (_br_fixed_pop(name##_shape(), &(ring->heads), ring->size_map,									\
+			ring->backing_store, dst, f));																									\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE size_t name##_peek_read_size(name##_t* ring)												\
+	{																																										\
+		return (_br_fixed_head_size(name##_shape(), ring->size_map, ring->heads.read));				\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE const uint8_t* name##_peek_read_data(name##_t* ring)								\
+	{																																										\
+		return (_br_fixed_line(name##_shape(), ring->backing_store, ring->heads.read));				\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE size_t name##_peek_write_size(name##_t* ring)												\
+	{																																										\
+		return (_br_fixed_head_size(name##_shape(), ring->size_map, ring->heads.write));			\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE const uint8_t* name##_peek_write_data(name##_t* ring)								\
+	{																																										\
+		return (_br_fixed_line(name##_shape(), ring->backing_store, ring->heads.write));			\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE int name##_is_ready(name##_t* ring, br_ready_for_pop f)													\
+	{																																										\
+		return (_br_fixed_call_ready(f, name##_peek_read_data(ring), name##_peek_read_size(ring)));	\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE bool name##_flag_is_set(name##_t* ring, BR_EVENT_FLAGS event_flag)			\
+	{																																										\
+		return (0 != (ring->heads.bit_flags & event_flag));																\
+	}																																										\
+																																											\
+	BR_FIXED_INLINE void name##_clear_flag(name##_t* ring, BR_EVENT_FLAGS event_flag)			\
+	{																																										\
+		ring->heads.bit_flags &= ~((uint32_t) event_flag);																	\
+	}
+
+#endif
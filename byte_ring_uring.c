@@ -0,0 +1,441 @@
+// MAP_POPULATE and syscall are only declared with a feature test macro
+#ifndef _GNU_SOURCE
+#	define _GNU_SOURCE
+#endif
+
+#include "byte_ring_uring.h"
+
+#ifdef __linux__
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+// the kernel side of the io_uring, mapped once by br_uring_create
+// the producer indices are published with release and the consumer indices loaded with acquire, like the ring heads
+typedef struct br_uring_queue
+{
+	unsigned*								head;
+	unsigned*								tail;
+	unsigned*								mask;
+	unsigned*								flags;
+	unsigned*								array;
+	void*										map;
+	size_t									map_size;
+} br_uring_queue_t;
+
+typedef struct br_uring_channel
+{
+	byte_ring_t*						ring;
+	int											fd;
+	BR_URING_DIRECTION			direction;
+	int											status;
+	int											buffer_index;
+	bool										in_flight;
+
+	// how much of the read line egress has written so far
+	size_t									done;
+} br_uring_channel_t;
+
+struct br_uring
+{
+	int											fd;
+	unsigned								setup_flags;
+	unsigned								in_flight;
+	bool										registered;
+
+	br_uring_queue_t				sq;
+	br_uring_queue_t				cq;
+	struct io_uring_sqe*		sqes;
+	size_t									sqes_size;
+	struct io_uring_cqe*		cqes;
+
+	// queued since the last io_uring_enter
+	unsigned								pending;
+
+	size_t									number_channels;
+	size_t									max_channels;
+	br_uring_channel_t			channels[];
+};
+
+inline static int br_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+	return ((int) syscall(SYS_io_uring_setup, entries, params));
+}
+
+inline static int br_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+	return ((int) syscall(SYS_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+inline static int br_uring_register(int fd, unsigned opcode, const void* arg, unsigned n)
+{
+	return ((int) syscall(SYS_io_uring_register, fd, opcode, arg, n));
+}
+
+// the user_data of the cancellations br_uring_destroy queues, every other completion carries a channel number
+#define BR_URING_CANCEL_DATA			UINT64_MAX
+
+inline static unsigned* br_uring_field(void* map, uint32_t offset)
+{
+	return ((unsigned*) ((uint8_t*) map + offset));
+}
+
+static bool br_uring_map(br_uring_t* engine, const struct io_uring_params* params)
+{
+	bool function_value = false;
+	engine->sq.map_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+	engine->cq.map_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+	// newer kernels hand out both queues in one mapping
+	if(0 != (params->features & IORING_FEAT_SINGLE_MMAP))
+	{
+		if(engine->sq.map_size < engine->cq.map_size) { engine->sq.map_size = engine->cq.map_size; }
+		engine->cq.map_size = 0;
+	}
+
+	engine->sq.map = mmap(NULL, engine->sq.map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		engine->fd, IORING_OFF_SQ_RING);
+	if(MAP_FAILED == engine->sq.map) { engine->sq.map = NULL; goto function_exit; }
+
+	engine->cq.map = engine->sq.map;
+	if(0 != engine->cq.map_size)
+	{
+		engine->cq.map = mmap(NULL, engine->cq.map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			engine->fd, IORING_OFF_CQ_RING);
+		if(MAP_FAILED == engine->cq.map) { engine->cq.map = NULL; goto function_exit; }
+	}
+
+	engine->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+	engine->sqes = mmap(NULL, engine->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		engine->fd, IORING_OFF_SQES);
+	if(MAP_FAILED == engine->sqes) { engine->sqes = NULL; goto function_exit; }
+
+	engine->sq.head		= br_uring_field(engine->sq.map, params->sq_off.head);
+	engine->sq.tail		= br_uring_field(engine->sq.map, params->sq_off.tail);
+	engine->sq.mask		= br_uring_field(engine->sq.map, params->sq_off.ring_mask);
+	engine->sq.flags	= br_uring_field(engine->sq.map, params->sq_off.flags);
+	engine->sq.array	= br_uring_field(engine->sq.map, params->sq_off.array);
+
+	engine->cq.head		= br_uring_field(engine->cq.map, params->cq_off.head);
+	engine->cq.tail		= br_uring_field(engine->cq.map, params->cq_off.tail);
+	engine->cq.mask		= br_uring_field(engine->cq.map, params->cq_off.ring_mask);
+	engine->cqes			= (struct io_uring_cqe*) br_uring_field(engine->cq.map, params->cq_off.cqes);
+	function_value		= true;
+
+function_exit:
+	return (function_value);
+}
+
+static void br_uring_unmap(br_uring_t* engine)
+{
+	if(NULL != engine->sqes) { munmap(engine->sqes, engine->sqes_size); }
+	if((NULL != engine->cq.map) && (engine->cq.map != engine->sq.map)) { munmap(engine->cq.map, engine->cq.map_size); }
+	if(NULL != engine->sq.map) { munmap(engine->sq.map, engine->sq.map_size); }
+}
+
+br_uring_t* br_uring_create(unsigned entries, size_t max_channels, unsigned setup_flags)
+{
+	struct io_uring_params params;
+	br_uring_t* function_value = calloc(1, sizeof(br_uring_t) + max_channels * sizeof(br_uring_channel_t));
+	if(NULL == function_value) { goto fail_early; }
+
+	memset(&params, 0, sizeof(params));
+	params.flags = setup_flags;
+
+	function_value->fd = br_uring_setup(entries, &params);
+	if(function_value->fd < 0) { goto fail_setup; }
+
+	if(false == br_uring_map(function_value, &params)) { goto fail_map; }
+
+	function_value->setup_flags		= setup_flags;
+	function_value->max_channels	= max_channels;
+	return (function_value);
+
+fail_map:
+	br_uring_unmap(function_value);
+	close(function_value->fd);
+fail_setup:
+	free(function_value);
+	function_value = NULL;
+fail_early:
+	return (function_value);
+}
+
+int br_uring_add(br_uring_t* engine, byte_ring_t* ring, int fd, BR_URING_DIRECTION direction)
+{
+	int function_value = -1;
+	if((engine->max_channels <= engine->number_channels) || (true == engine->registered)) { goto function_exit; }
+
+	br_uring_channel_t* channel = &(engine->channels[engine->number_channels]);
+	channel->ring						= ring;
+	channel->fd							= fd;
+	channel->direction			= direction;
+	channel->status					= 1;
+	channel->buffer_index		= -1;
+	channel->in_flight			= false;
+	channel->done						= 0;
+	function_value					= (int) engine->number_channels;
+	engine->number_channels	+= 1;
+
+function_exit:
+	return (function_value);
+}
+
+bool br_uring_register_buffers(br_uring_t* engine)
+{
+	bool function_value = false;
+	unsigned count = 0;
+	if((true == engine->registered) || (0 == engine->number_channels)) { goto function_exit; }
+
+	struct iovec* buffers = calloc(engine->number_channels, sizeof(struct iovec));
+	if(NULL == buffers) { goto function_exit; }
+
+	// rings on several channels share one registered buffer
+	for(size_t i = 0; i < engine->number_channels; i++)
+	{
+		br_span_t store;
+		br_get_backing_store(engine->channels[i].ring, &store);
+
+		unsigned index = 0;
+		while((index < count) && (buffers[index].iov_base != (void*) store.data)) { index++; }
+
+		if(index == count)
+		{
+			buffers[count].iov_base	= (void*) store.data;
+			buffers[count].iov_len	= store.size;
+			count += 1;
+		}
+
+		engine->channels[i].buffer_index = (int) index;
+	}
+
+	function_value = (0 == br_uring_register(engine->fd, IORING_REGISTER_BUFFERS, buffers, count));
+	free(buffers);
+
+	for(size_t i = 0; (false == function_value) && (i < engine->number_channels); i++)
+	{
+		engine->channels[i].buffer_index = -1;
+	}
+
+	engine->registered = function_value;
+
+function_exit:
+	return (function_value);
+}
+
+inline static struct io_uring_sqe* br_uring_get_sqe(br_uring_t* engine)
+{
+	struct io_uring_sqe* function_value = NULL;
+	unsigned head = __atomic_load_n(engine->sq.head, __ATOMIC_ACQUIRE);
+	unsigned tail = *(engine->sq.tail) + engine->pending;
+	if(*(engine->sq.mask) < tail - head) { goto function_exit; }
+
+	unsigned index = tail & *(engine->sq.mask);
+	engine->sq.array[index] = index;
+	function_value = &(engine->sqes[index]);
+	memset(function_value, 0, sizeof(struct io_uring_sqe));
+	engine->pending += 1;
+
+function_exit:
+	return (function_value);
+}
+
+// the bytes a channel can move right now, or 0 when it has to wait for the other side of its ring
+static size_t br_uring_get_work(br_uring_channel_t* channel, uint8_t** data)
+{
+	size_t function_value = 0;
+	byte_ring_t* ring = channel->ring;
+
+	if(BR_URING_INGEST == channel->direction)
+	{
+		// making room can move the write head past a full line, which a batched ring would hold back
+		function_value = br_write_reserve(ring, SIZE_MAX, data);
+		br_flush(ring);
+		goto function_exit;
+	}
+
+	// a popped read line is empty, the next line may be waiting behind it
+	size_t size = br_peek_read_size(ring);
+	while((0 == size) && (true == br_seek(ring))) { size = br_peek_read_size(ring); }
+
+	*data = (uint8_t*) br_peek_read_data(ring) + channel->done;
+	function_value = size - channel->done;
+
+function_exit:
+	return (function_value);
+}
+
+static void br_uring_queue(br_uring_t* engine)
+{
+	for(size_t i = 0; i < engine->number_channels; i++)
+	{
+		br_uring_channel_t* channel = &(engine->channels[i]);
+		if((true == channel->in_flight) || (1 != channel->status)) { continue; }
+
+		uint8_t* data = NULL;
+		size_t size = br_uring_get_work(channel, &data);
+		if(0 == size) { continue; }
+
+		struct io_uring_sqe* sqe = br_uring_get_sqe(engine);
+		if(NULL == sqe) { break; }
+
+		// offset -1 reads and writes at the file position, which is what streams use anyway
+		bool ingest = (BR_URING_INGEST == channel->direction);
+		sqe->opcode = ingest ? IORING_OP_READ : IORING_OP_WRITE;
+		if(0 <= channel->buffer_index)
+		{
+			sqe->opcode			= ingest ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+			sqe->buf_index	= (uint16_t) channel->buffer_index;
+		}
+
+		sqe->fd					= channel->fd;
+		sqe->off				= (uint64_t) -1;
+		sqe->addr				= (uint64_t) (uintptr_t) data;
+		sqe->len				= (uint32_t) ((UINT32_MAX < size) ? UINT32_MAX : size);
+		sqe->user_data	= i;
+
+		channel->in_flight	= true;
+		engine->in_flight		+= 1;
+	}
+}
+
+static void br_uring_complete(br_uring_t* engine, const struct io_uring_cqe* cqe)
+{
+	// a cancellation only says whether it found its operation, which completes on its own
+	if(BR_URING_CANCEL_DATA == cqe->user_data) { goto function_exit; }
+
+	br_uring_channel_t* channel = &(engine->channels[cqe->user_data]);
+	byte_ring_t* ring = channel->ring;
+	channel->in_flight	= false;
+	engine->in_flight		-= 1;
+
+	if((-EAGAIN == cqe->res) || (-EINTR == cqe->res)) { goto function_exit; }
+	if(cqe->res < 0) { channel->status = cqe->res; goto function_exit; }
+
+	if(BR_URING_INGEST == channel->direction)
+	{
+		// br_write_reserve made room for the read, so the bytes fit the write line
+		if(0 == cqe->res) { channel->status = 0; goto function_exit; }
+		br_write_commit(ring, (size_t) cqe->res);
+		br_advance_write_head(ring);
+		br_flush(ring);
+		goto function_exit;
+	}
+
+	channel->done += (size_t) cqe->res;
+	if(br_peek_read_size(ring) <= channel->done)
+	{
+		channel->done = 0;
+		br_read_release(ring);
+	}
+
+function_exit:
+	return;
+}
+
+// submits what was queued, waits for wait_for completions and hands every completion over, see br_uring_run
+static int br_uring_submit(br_uring_t* engine, unsigned wait_for)
+{
+	int function_value = 0;
+
+	// nothing completes when nothing is in flight
+	if(engine->in_flight < wait_for) { wait_for = engine->in_flight; }
+
+	unsigned submit = engine->pending;
+	__atomic_store_n(engine->sq.tail, *(engine->sq.tail) + submit, __ATOMIC_RELEASE);
+	engine->pending = 0;
+
+	unsigned flags = (0 != wait_for) ? IORING_ENTER_GETEVENTS : 0;
+	bool enter = ((0 != submit) || (0 != wait_for));
+
+	// the kernel thread picks submissions up by itself, unless it went to sleep
+	if(0 != (engine->setup_flags & IORING_SETUP_SQPOLL))
+	{
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if(0 != (__atomic_load_n(engine->sq.flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP))
+		{
+			flags |= IORING_ENTER_SQ_WAKEUP;
+		}
+
+		enter = ((0 != wait_for) || (0 != (flags & IORING_ENTER_SQ_WAKEUP)));
+		submit = 0;
+	}
+
+	if((true == enter) && (br_uring_enter(engine->fd, submit, wait_for, flags) < 0))
+	{
+		function_value = -1;
+		goto function_exit;
+	}
+
+	unsigned head = *(engine->cq.head);
+	unsigned tail = __atomic_load_n(engine->cq.tail, __ATOMIC_ACQUIRE);
+	for(; head != tail; head++, function_value++)
+	{
+		br_uring_complete(engine, &(engine->cqes[head & *(engine->cq.mask)]));
+	}
+
+	__atomic_store_n(engine->cq.head, head, __ATOMIC_RELEASE);
+
+function_exit:
+	return (function_value);
+}
+
+int br_uring_run(br_uring_t* engine, unsigned wait_for)
+{
+	br_uring_queue(engine);
+	return (br_uring_submit(engine, wait_for));
+}
+
+// asks the kernel to cancel the operation in flight on every channel, returns false when the queue had no room
+static bool br_uring_cancel(br_uring_t* engine)
+{
+	bool function_value = true;
+
+	for(size_t i = 0; i < engine->number_channels; i++)
+	{
+		if(false == engine->channels[i].in_flight) { continue; }
+
+		struct io_uring_sqe* sqe = br_uring_get_sqe(engine);
+		if(NULL == sqe) { function_value = false; break; }
+
+		sqe->opcode			= IORING_OP_ASYNC_CANCEL;
+		sqe->fd					= -1;
+		sqe->addr				= (uint64_t) i;
+		sqe->user_data	= BR_URING_CANCEL_DATA;
+	}
+
+	return (function_value);
+}
+
+void br_uring_destroy(br_uring_t** engine)
+{
+	br_uring_t* doomed = *engine;
+
+	// an operation the kernel already started may still finish instead of being cancelled
+	// either way its completion is waited for and handed to its ring, after that nothing touches the rings or buffers
+	if((0 != doomed->in_flight) && (false == br_uring_cancel(doomed)))
+	{
+		br_uring_submit(doomed, 0);
+		br_uring_cancel(doomed);
+	}
+
+	while(0 != doomed->in_flight)
+	{
+		if((br_uring_submit(doomed, 1) < 0) && (EINTR != errno)) { break; }
+	}
+
+	// closing the io_uring waits for the kernel to let go of the registered buffers
+	br_uring_unmap(*engine);
+	close((*engine)->fd);
+	free(*engine);
+	*engine = NULL;
+}
+
+int br_uring_get_status(br_uring_t* engine, int channel)
+{
+	return (engine->channels[channel].status);
+}
+#endif
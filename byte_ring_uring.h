@@ -0,0 +1,53 @@
+#ifndef __BYTE_RING_URING_H__
+#define __BYTE_RING_URING_H__
+
+#include "byte_ring.h"
+
+// an io_uring engine that moves bytes between file descriptors and rings, linux only
+// every channel ties one ring to one fd, either filling the ring from the fd or emptying it into the fd
+//		ingest reads into the free space of the write line, the write head is advanced after every read that completes
+//		egress writes the read line out, a line that went out in part has its rest written next, then it is released
+// the engine is the producer of its ingest rings and the consumer of its egress rings,
+//		so br_uring_run has to be called from the one thread that plays those parts
+// each channel has at most one read or write in flight, so the bytes of a stream stay in order
+//
+// br_uring_t* engine = br_uring_create(64, 8, 0);
+// int in = br_uring_add(engine, ring, socket_fd, BR_URING_INGEST);
+// br_uring_register_buffers(engine);
+// while(0 <= br_uring_run(engine, 1)) { ... }
+
+typedef struct br_uring br_uring_t;
+
+typedef enum BR_URING_DIRECTION
+{
+	BR_URING_INGEST	= 0,
+	BR_URING_EGRESS	= 1,
+} BR_URING_DIRECTION;
+
+// returns an engine with an io_uring of entries submission entries and room for max_channels channels
+//		setup_flags go to io_uring_setup, IORING_SETUP_SQPOLL lets the steady state run without syscalls
+//		returns NULL when the io_uring cannot be set up
+br_uring_t* br_uring_create(unsigned entries, size_t max_channels, unsigned setup_flags);
+// tears down the io_uring, the rings and fds stay the caller's
+//		operations still in flight are cancelled, and their completions are waited for and handed to their rings first
+//		an operation the kernel already started may complete instead, so its bytes still land in its ring
+//		only when waiting fails with an error other than EINTR is the io_uring closed with operations in flight,
+//		then the kernel finishes them after this returns
+void br_uring_destroy(br_uring_t** engine);
+
+// adds a channel, returns its number or -1 when the engine is full or buffers are registered already
+int br_uring_add(br_uring_t* engine, byte_ring_t* ring, int fd, BR_URING_DIRECTION direction);
+// registers the backing store of every channel's ring once with IORING_REGISTER_BUFFERS,
+//		the channels use fixed buffer reads and writes after that, channels cannot be added any more
+//		returns false when the kernel refuses, then the engine keeps working without registered buffers
+bool br_uring_register_buffers(br_uring_t* engine);
+
+// queues a read or write for every idle channel that has room or data for one, submits them,
+//		waits for at least wait_for completions when that many are in flight, and hands every completion to its ring
+//		returns the number of completions handled, -1 with errno set when io_uring_enter fails
+int br_uring_run(br_uring_t* engine, unsigned wait_for);
+// 1 while the channel is open, 0 once its fd reached the end of the file, otherwise the negative errno it failed with
+//		a channel that is not open is not queued again
+int br_uring_get_status(br_uring_t* engine, int channel);
+
+#endif